@@ -0,0 +1,447 @@
+#include "batch.hpp"
+#include "cgroup.hpp"
+#include "container.hpp"
+#include "event_loop.hpp"
+#include "histogram.hpp"
+#include "json.hpp"
+#include "pressure.hpp"
+#include "scheduler.hpp"
+#include "state.hpp"
+#include "tenant.hpp"
+#include "trace.hpp"
+#include "work_pool.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+
+// One line of the jobs file and what became of it
+struct BatchJob {
+    std::string name;
+    ContainerConfig config;
+    Container container;
+    int priority = 0;
+    double timeout_s = 0;        // Stopped once it has run this long, 0 = never
+    bool timed_out = false;
+    int timer_fd = -1;           // Pending deadline or grace period timer
+    std::string rejected;        // Why it was never launched: "capacity" or "pressure"
+    bool started = false;
+    int status = -1;
+    uint64_t queued_ns = 0;      // From the start of the batch until admitted
+    uint64_t setup_ns = 0;       // create_container() + start_container()
+    uint64_t teardown_ns = 0;    // Reading the usage + destroy_container()
+    long long cpu_usec = -1;     // cpu.stat usage_usec at exit
+    long long mem_peak = -1;     // memory.peak at exit
+};
+
+// A setup or teardown task finished on the pool
+struct BatchEvent {
+    size_t job;
+    bool setup;
+};
+
+static std::string describe_status(const BatchJob &job) {
+    int status = job.status;
+    if (!job.rejected.empty()) {
+        return "rejected (" + job.rejected + ")";
+    }
+    if (status == -1) {
+        return "error";
+    }
+    std::string timeout = job.timed_out ? " (timeout)" : "";
+    if (WIFSIGNALED(status)) {
+        return std::string("signal ") + strsignal(WTERMSIG(status)) + timeout;
+    }
+    return "exit " + std::to_string(WEXITSTATUS(status)) + timeout;
+}
+
+// Parses a whole JSON number (or a string holding one) as an integer in
+// [min, max]: fractions, exponents and trailing characters are refused
+static bool parse_integer(const JsonValue &value, long long min, long long max, long long &number) {
+    const char *start = value.text.c_str();
+    char *end = nullptr;
+    errno = 0;
+    number = strtoll(start, &end, 10);
+    return end != start && *end == '\0' && errno != ERANGE && number >= min && number <= max;
+}
+
+static bool parse_number(const JsonValue &value, double &number) {
+    const char *start = value.text.c_str();
+    char *end = nullptr;
+    number = strtod(start, &end);
+    return end != start && *end == '\0' && std::isfinite(number);
+}
+
+// Fills a job from one parsed line. Keys: cmd (required), name, image
+// (a directory under ./images, or a path), mem, cpu, cpu_period, tenant,
+// sched (other, batch or idle), nice, timeout (s) and priority (higher is
+// admitted first). The names are strings, the rest numbers.
+static bool parse_job(const std::map<std::string, JsonValue> &fields, size_t line, const std::string &default_rootfs,
+                      const std::string &default_tenant, double default_timeout, BatchJob &job) {
+    job.name = "job" + std::to_string(line);
+    job.timeout_s = default_timeout;
+    job.config.rootfs = default_rootfs;
+    std::string tenant = default_tenant;
+    for (const auto &field : fields) {
+        const std::string &key = field.first;
+        const JsonValue &value = field.second;
+        bool string_key = key == "cmd" || key == "name" || key == "image" || key == "sched" || key == "tenant";
+        if (string_key && !value.is_string) {
+            std::cerr << "Value of " << key << " must be a string on line " << line << std::endl;
+            return false;
+        }
+        long long number = 0;
+        bool ok = true;
+        if (key == "cmd") {
+            job.config.cmd = value.text;
+        } else if (key == "name") {
+            job.name = value.text;
+        } else if (key == "image") {
+            job.config.rootfs = value.text.find('/') == std::string::npos ? "./images/" + value.text : value.text;
+        } else if (key == "mem") {
+            ok = parse_integer(value, LLONG_MIN, LLONG_MAX, job.config.limits.mem_mb);
+        } else if (key == "cpu") {
+            ok = parse_integer(value, INT_MIN, INT_MAX, number);
+            job.config.limits.cpu_pct = number;
+        } else if (key == "cpu_period") {
+            ok = parse_integer(value, INT_MIN, INT_MAX, number);
+            job.config.limits.cpu_period_us = number;
+        } else if (key == "sched") {
+            if (!parse_sched_policy(value.text, job.config.sched.policy)) {
+                return false;
+            }
+        } else if (key == "nice") {
+            ok = parse_integer(value, INT_MIN, INT_MAX, number);
+            job.config.sched.nice = number;
+        } else if (key == "timeout") {
+            ok = parse_number(value, job.timeout_s);
+        } else if (key == "tenant") {
+            tenant = value.text;
+        } else if (key == "priority") {
+            ok = parse_integer(value, INT_MIN, INT_MAX, number);
+            job.priority = number;
+        } else {
+            std::cerr << "Unknown key \"" << key << "\" on line " << line << std::endl;
+            return false;
+        }
+        if (!ok) {
+            std::cerr << "Invalid value for " << key << " on line " << line << ": " << value.text << std::endl;
+            return false;
+        }
+    }
+    if (job.config.cmd.empty()) {
+        std::cerr << "Missing cmd on line " << line << std::endl;
+        return false;
+    }
+    if (job.timeout_s < 0) {
+        std::cerr << "Timeout must not be negative on line " << line << std::endl;
+        return false;
+    }
+    if (!validate_sched(job.config.sched) || (!tenant.empty() && !ensure_tenant(tenant, job.config.cgroup_parent))) {
+        return false;
+    }
+    return validate_limits(job.config.limits);
+}
+
+int batch_main(int argc, char *argv[]) {
+    cxxopts::Options options("dockher batch", "Run a file of container jobs, several at a time");
+    options.add_options()
+        ("file", "Jobs file, one JSON object per line", cxxopts::value<std::string>())
+        ("j,parallel", "Containers running at the same time", cxxopts::value<int>()->default_value("4"))
+        ("threads", "Threads setting up and tearing down containers (default: one per CPU)", cxxopts::value<int>())
+        ("cpu-overcommit", "Ratio of CPU the running jobs' --cpu may add up to", cxxopts::value<double>()->default_value("1.0"))
+        ("mem-overcommit", "Ratio of memory the running jobs' --mem may add up to", cxxopts::value<double>()->default_value("1.0"))
+        ("default-mem", "Memory counted for jobs without a mem limit (MB)", cxxopts::value<long long>()->default_value("0"))
+        ("max-cpu-pressure", "Hold launches while CPU stall (PSI some avg10) is above this (%)", cxxopts::value<double>())
+        ("max-mem-pressure", "Hold launches while memory stall (PSI some avg10) is above this (%)", cxxopts::value<double>())
+        ("max-io-pressure", "Hold launches while IO stall (PSI some avg10) is above this (%)", cxxopts::value<double>())
+        ("pressure-timeout", "Reject the waiting jobs once launches have been held this long (ms)", cxxopts::value<long>()->default_value("30000"))
+        ("timeout", "Stop jobs without a timeout of their own after this long (s, 0 = never)", cxxopts::value<double>()->default_value("0"))
+        ("stop-grace", "Time a stopped job gets to exit after SIGTERM before it is killed (s)", cxxopts::value<double>()->default_value("10"))
+        ("tenant", "Tenant of jobs without one of their own", cxxopts::value<std::string>()->default_value(""))
+        ("rootfs", "Root filesystem of jobs without an image", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("h,help", "Print usage");
+    options.parse_positional({"file"});
+    options.positional_help("<jobs.jsonl>");
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("file")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+    int parallel = result["parallel"].as<int>();
+    int threads = result.count("threads") ? result["threads"].as<int>()
+                                          : static_cast<int>(std::thread::hardware_concurrency());
+    if (parallel < 1 || threads < 1) {
+        std::cerr << "--parallel and --threads must be at least 1" << std::endl;
+        return 1;
+    }
+    double cpu_overcommit = result["cpu-overcommit"].as<double>();
+    double mem_overcommit = result["mem-overcommit"].as<double>();
+    long long default_mem = result["default-mem"].as<long long>();
+    if (cpu_overcommit <= 0 || mem_overcommit <= 0 || default_mem < 0) {
+        std::cerr << "Overcommit ratios must be positive and --default-mem not negative" << std::endl;
+        return 1;
+    }
+    PressureThresholds thresholds;
+    thresholds.cpu = result.count("max-cpu-pressure") ? result["max-cpu-pressure"].as<double>() : -1;
+    thresholds.memory = result.count("max-mem-pressure") ? result["max-mem-pressure"].as<double>() : -1;
+    thresholds.io = result.count("max-io-pressure") ? result["max-io-pressure"].as<double>() : -1;
+    thresholds.timeout_ms = result["pressure-timeout"].as<long>();
+
+    std::string path = result["file"].as<std::string>();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open: " << path << " — " << strerror(errno) << std::endl;
+        return 1;
+    }
+    // Sized up front: the pool's tasks hold pointers into it
+    std::vector<std::map<std::string, JsonValue>> lines;
+    std::vector<size_t> line_numbers;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); number++) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        lines.emplace_back();
+        line_numbers.push_back(number);
+        if (!parse_flat_json(line, lines.back())) {
+            std::cerr << "On line " << number << " of " << path << std::endl;
+            return 1;
+        }
+    }
+    std::vector<BatchJob> jobs(lines.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (!parse_job(lines[i], line_numbers[i], result["rootfs"].as<std::string>(), result["tenant"].as<std::string>(),
+                       result["timeout"].as<double>(), jobs[i])) {
+            return 1;
+        }
+    }
+    if (jobs.empty()) {
+        std::cerr << "No jobs in " << path << std::endl;
+        return 1;
+    }
+
+    // Setup and teardown (cgroup writes, clone, waiting for exec, reading
+    // usage, rmdir) run on the pool; the main thread only watches pidfds
+    // and decides what to launch next, so a slow teardown never holds up
+    // the next launch. Finished tasks are handed back through an eventfd.
+    EventLoop loop;
+    std::mutex events_mutex;
+    std::vector<BatchEvent> events;
+    int done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (done_fd == -1) {
+        std::cerr << "Failed to create eventfd: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    auto post = [&](size_t job, bool setup) {
+        {
+            std::lock_guard<std::mutex> lock(events_mutex);
+            events.push_back({job, setup});
+        }
+        uint64_t one = 1;
+        if (write(done_fd, &one, sizeof(one)) == -1) {
+            std::cerr << "Failed to write eventfd: " << strerror(errno) << std::endl;
+        }
+    };
+
+    // Jobs are admitted while their limits fit what the host has left, so a
+    // burst of jobs queues up instead of oversubscribing memory. A job
+    // without a CPU limit counts as a whole CPU.
+    HostCapacity capacity = host_capacity(cpu_overcommit, mem_overcommit);
+    AdmissionScheduler scheduler(capacity);
+    size_t running = 0, finished = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const Limits &limits = jobs[i].config.limits;
+        ResourceRequest request;
+        request.cpu_pct = limits.cpu_pct > 0 ? limits.cpu_pct : 100;
+        request.mem_mb = limits.mem_mb != -1 ? limits.mem_mb : default_mem;
+        request.priority = jobs[i].priority;
+        if (!scheduler.enqueue(i, request)) {
+            std::cerr << "Job " << jobs[i].name << " needs more than the host has (" << request.cpu_pct << "% CPU, "
+                      << request.mem_mb << " MB)" << std::endl;
+            jobs[i].rejected = "capacity";
+            finished++;
+        }
+    }
+    // Capacity cannot see a host that is already stalling on something
+    // else, so launches are also held while it is under pressure
+    long grace_ms = static_cast<long>(result["stop-grace"].as<double>() * 1000);
+    if (grace_ms < 0) {
+        std::cerr << "--stop-grace must not be negative" << std::endl;
+        return 1;
+    }
+    std::string tenant = result["tenant"].as<std::string>();
+    PressureGate gate(thresholds, tenant.empty() ? CGROUP_ROOT : tenant_cgroup(tenant));
+    bool retry_armed = false;
+    uint64_t batch_start = monotonic_ns();
+    {
+        WorkStealingPool pool(threads);
+
+        auto teardown = [&](size_t i) {
+            pool.submit([&, i]() {
+                BatchJob &job = jobs[i];
+                job.status = wait_container(job.container);
+                uint64_t start = monotonic_ns();
+                job.cpu_usec = read_cgroup_stat(job.container.cgroup + "/cpu.stat", "usage_usec");
+                job.mem_peak = read_cgroup_value(job.container.cgroup + "/memory.peak");
+                remove_state(job.container.pid);
+                destroy_container(job.container);
+                job.teardown_ns = monotonic_ns() - start;
+                post(i, false);
+            });
+        };
+
+        std::function<void()> launch = [&]() {
+            if (retry_armed || scheduler.waiting() == 0 || running >= static_cast<size_t>(parallel)) {
+                return;
+            }
+            std::string reason;
+            PressureGate::Decision decision = gate.check(reason);
+            if (decision == PressureGate::DELAY) {
+                // Checked again after the backoff, or when a job finishes
+                retry_armed = true;
+                loop.add_timer(gate.backoff_ms(), [&]() {
+                    retry_armed = false;
+                    launch();
+                    if (finished == jobs.size()) {
+                        loop.stop();
+                    }
+                }, false);
+                return;
+            }
+            if (decision == PressureGate::REJECT) {
+                std::cerr << "Rejecting " << scheduler.waiting() << " waiting job(s): " << reason << std::endl;
+                for (size_t i : scheduler.drain()) {
+                    jobs[i].rejected = "pressure";
+                    finished++;
+                }
+                return;
+            }
+            for (size_t i : scheduler.admit(parallel - running)) {
+                running++;
+                jobs[i].queued_ns = monotonic_ns() - batch_start;
+                pool.submit([&, i]() {
+                    BatchJob &job = jobs[i];
+                    uint64_t start = monotonic_ns();
+                    if (create_container(job.config, job.container)) {
+                        ContainerState state;
+                        state.pid = job.container.pid;
+                        state.supervisor = getpid();
+                        state.cgroup = job.container.cgroup;
+                        state.rootfs = job.config.rootfs;
+                        state.cmd = job.config.cmd;
+                        save_state(state);
+                        job.started = start_container(job.container);
+                        if (!job.started) {
+                            remove_state(job.container.pid);
+                            destroy_container(job.container);
+                        }
+                    }
+                    job.setup_ns = monotonic_ns() - start;
+                    post(i, true);
+                });
+            }
+        };
+
+        loop.add(done_fd, [&]() {
+            uint64_t count;
+            if (read(done_fd, &count, sizeof(count)) == -1) {
+                return;
+            }
+            std::vector<BatchEvent> ready;
+            {
+                std::lock_guard<std::mutex> lock(events_mutex);
+                ready.swap(events);
+            }
+            for (const BatchEvent &event : ready) {
+                BatchJob &job = jobs[event.job];
+                if (event.setup && job.started) {
+                    // Torn down once the pidfd reports the exit
+                    int pidfd = job.container.pidfd;
+                    size_t i = event.job;
+                    loop.add(pidfd, [&, pidfd, i]() {
+                        loop.remove(pidfd);
+                        if (jobs[i].timer_fd != -1) {
+                            loop.remove(jobs[i].timer_fd);
+                        }
+                        teardown(i);
+                    });
+                    // Past its deadline the job gets SIGTERM, and once the
+                    // grace period is over too, its cgroup is killed
+                    if (job.timeout_s > 0) {
+                        job.timer_fd = loop.add_timer(static_cast<long>(job.timeout_s * 1000), [&, i]() {
+                            BatchJob &late = jobs[i];
+                            late.timed_out = true;
+                            kill(late.container.pid, SIGTERM);
+                            late.timer_fd = loop.add_timer(std::max(grace_ms, 1L), [&, i]() {
+                                jobs[i].timer_fd = -1;
+                                std::string cgroup = jobs[i].container.cgroup;
+                                pool.submit([cgroup]() { kill_cgroup(cgroup); });
+                            }, false);
+                        }, false);
+                    }
+                    continue;
+                }
+                // Either teardown finished or setup failed: the slot is free
+                scheduler.release(event.job);
+                running--;
+                finished++;
+            }
+            launch();
+            if (finished == jobs.size()) {
+                loop.stop();
+            }
+        });
+
+        launch();
+        if (finished < jobs.size()) {
+            loop.run();
+        }
+    }
+    close(done_fd);
+    uint64_t wall_ns = monotonic_ns() - batch_start;
+
+    std::cout << std::left << std::setw(16) << "job" << std::setw(28) << "command" << std::right
+              << std::setw(10) << "queued" << std::setw(10) << "setup" << std::setw(12) << "runtime" << std::setw(10) << "teardown"
+              << std::setw(12) << "cpu" << std::setw(14) << "memory.peak" << "  status" << std::endl;
+    int failed = 0;
+    for (const BatchJob &job : jobs) {
+        bool ok = job.status != -1 && WIFEXITED(job.status) && WEXITSTATUS(job.status) == 0;
+        failed += !ok;
+        std::cout << std::left << std::setw(16) << job.name.substr(0, 15) << std::setw(28) << job.config.cmd.substr(0, 26)
+                  << std::right << std::setw(10) << (job.rejected.empty() ? format_ns(job.queued_ns) : "-")
+                  << std::setw(10) << (job.rejected.empty() ? format_ns(job.setup_ns) : "-")
+                  << std::setw(12) << (job.started ? format_ns(job.container.exited_ns - job.container.exec_ns) : "-")
+                  << std::setw(10) << (job.started ? format_ns(job.teardown_ns) : "-")
+                  << std::setw(12) << (job.cpu_usec == -1 ? "-" : format_ns(job.cpu_usec * 1000))
+                  << std::setw(14) << (job.mem_peak == -1 ? "-" : std::to_string(job.mem_peak / 1024) + " KB")
+                  << "  " << describe_status(job) << std::endl;
+    }
+    std::cout << jobs.size() << " job(s) in " << format_ns(wall_ns) << " ("
+              << std::fixed << std::setprecision(1) << jobs.size() * 1e9 / wall_ns << " jobs/s, "
+              << parallel << " at a time, " << threads << " setup thread(s)), " << failed << " failed" << std::endl;
+    std::cout << "Admitted up to " << scheduler.peak().cpu_pct << "% of " << capacity.cpu_pct << "% CPU and "
+              << scheduler.peak().mem_mb << " of " << capacity.mem_mb << " MB at once" << std::endl;
+    if (thresholds.enabled()) {
+        std::cout << "Pressure held launches " << gate.stalls() << " time(s) for " << format_ns(gate.held_ns())
+                  << " in total (worst " << gate.worst() << "%), and rejected the waiting jobs " << gate.rejections()
+                  << " time(s)" << std::endl;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// dockher batch <jobs.jsonl> [--parallel N] [--threads N]
+// Runs one container per job line with up to N at a time, admitting jobs by
+// priority only while their limits fit the host, and prints each job's
+// runtime and resource usage once all of them are done
+int batch_main(int argc, char *argv[]);
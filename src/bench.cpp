@@ -0,0 +1,168 @@
+#include "bench.hpp"
+#include "container.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+
+int bench_main(int argc, char *argv[]) {
+    // The suite name is optional and defaults to the lifecycle latency suite
+    std::string suite = (argc > 1 && argv[1][0] != '-') ? argv[1] : "latency";
+    if (argc > 1 && argv[1][0] != '-') {
+        argc--;
+        argv++;
+    }
+
+    if (suite == "latency") {
+        return bench_latency(argc, argv);
+    }
+    if (suite == "limits") {
+        return bench_limits(argc, argv);
+    }
+    if (suite == "churn") {
+        return bench_churn(argc, argv);
+    }
+    if (suite == "density") {
+        return bench_density(argc, argv);
+    }
+    if (suite == "ns") {
+        return bench_ns(argc, argv);
+    }
+    if (suite == "net") {
+        return bench_net(argc, argv);
+    }
+    std::cerr << "Unknown benchmark suite: " << suite << " (available: latency, limits, churn, density, ns, net)" << std::endl;
+    return 1;
+}
+
+void print_latency_header() {
+    std::cout << std::left << std::setw(16) << "phase" << std::right
+              << std::setw(11) << "p50" << std::setw(11) << "p90" << std::setw(11) << "p99"
+              << std::setw(11) << "p999" << std::setw(11) << "max" << std::endl;
+}
+
+void print_latency_row(const std::string &name, const HdrHistogram &histogram) {
+    std::cout << std::left << std::setw(16) << name << std::right
+              << std::setw(11) << format_ns(histogram.percentile(50))
+              << std::setw(11) << format_ns(histogram.percentile(90))
+              << std::setw(11) << format_ns(histogram.percentile(99))
+              << std::setw(11) << format_ns(histogram.percentile(99.9))
+              << std::setw(11) << format_ns(histogram.max()) << std::endl;
+}
+
+// Per-worker results, merged once all workers are done
+struct LatencyResults {
+    HdrHistogram to_exec;
+    HdrHistogram to_exit;
+    HdrHistogram teardown;
+    int failures = 0;
+};
+
+// Runs one container through its whole lifecycle, recording each phase
+static bool measure_one(const ContainerConfig &config, LatencyResults *results) {
+    Container container;
+    if (!create_container(config, container)) {
+        return false;
+    }
+    if (!start_container(container)) {
+        destroy_container(container);
+        return false;
+    }
+    int status = wait_container(container);
+    uint64_t teardown_start = monotonic_ns();
+    destroy_container(container);
+    uint64_t teardown_end = monotonic_ns();
+
+    if (results) {
+        results->to_exec.record(container.exec_ns - container.created_ns);
+        results->to_exit.record(container.exited_ns - container.created_ns);
+        results->teardown.record(teardown_end - teardown_start);
+    }
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// dockher bench latency --count N --concurrency C --cmd <cmd>
+int bench_latency(int argc, char *argv[]) {
+    cxxopts::Options options("dockher bench latency", "Measure container lifecycle latency");
+    options.add_options()
+        ("n,count", "Number of containers to launch", cxxopts::value<int>()->default_value("100"))
+        ("j,concurrency", "Containers in flight at once", cxxopts::value<int>()->default_value("1"))
+        ("warmup", "Containers launched before measuring", cxxopts::value<int>()->default_value("5"))
+        ("c,cmd", "Command each container runs", cxxopts::value<std::string>()->default_value("true"))
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("m,mem", "Memory limit (MB)", cxxopts::value<long long>()->default_value("64"))
+        ("p,cpu", "CPU limit (%)", cxxopts::value<int>()->default_value("0"))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    int count = result["count"].as<int>();
+    int concurrency = result["concurrency"].as<int>();
+    if (count < 1 || concurrency < 1) {
+        std::cerr << "--count and --concurrency must be at least 1" << std::endl;
+        return 1;
+    }
+
+    ContainerConfig config;
+    config.cmd = result["cmd"].as<std::string>();
+    config.rootfs = result["rootfs"].as<std::string>();
+    config.limits.mem_mb = result["mem"].as<long long>();
+    config.limits.cpu_pct = result["cpu"].as<int>();
+    if (!validate_limits(config.limits)) {
+        return 1;
+    }
+
+    // Warm the page cache and dentries so the first measured launch is not an outlier
+    for (int i = 0; i < result["warmup"].as<int>(); i++) {
+        measure_one(config, nullptr);
+    }
+
+    // Workers pull launch slots from a shared counter until all are taken
+    std::atomic<int> next(0);
+    std::vector<LatencyResults> results(concurrency);
+    std::vector<std::thread> workers;
+    uint64_t start = monotonic_ns();
+    for (int w = 0; w < concurrency; w++) {
+        workers.emplace_back([&, w]() {
+            while (next.fetch_add(1) < count) {
+                if (!measure_one(config, &results[w])) {
+                    results[w].failures++;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+
+    LatencyResults total;
+    for (const LatencyResults &r : results) {
+        total.to_exec.add(r.to_exec);
+        total.to_exit.add(r.to_exit);
+        total.teardown.add(r.teardown);
+        total.failures += r.failures;
+    }
+
+    std::cout << "Lifecycle latency: " << count << " containers, concurrency " << concurrency
+              << ", cmd \"" << config.cmd << "\"" << std::endl;
+    print_latency_header();
+    print_latency_row("time-to-exec", total.to_exec);
+    print_latency_row("time-to-exit", total.to_exit);
+    print_latency_row("teardown", total.teardown);
+    std::cout << "Throughput: " << std::fixed << std::setprecision(1)
+              << count / (elapsed / 1e9) << " containers/s" << std::endl;
+    if (total.failures) {
+        std::cout << "Failures: " << total.failures << std::endl;
+    }
+    return total.failures ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include "histogram.hpp"
+
+// dockher bench [suite] [options]: dispatches to one benchmark suite
+int bench_main(int argc, char *argv[]);
+
+// Lifecycle latency: launches containers running a trivial command and
+// reports time-to-exec, time-to-exit and teardown percentiles
+int bench_latency(int argc, char *argv[]);
+
+// Limit accuracy: sweeps --cpu/--cpu-period and --mem with calibrated
+// burners and allocators and compares actual usage with the limits
+int bench_limits(int argc, char *argv[]);
+
+// Churn soak: creates and destroys containers at a high rate through
+// normal and abnormal lifecycles, then checks for leaked host resources
+int bench_churn(int argc, char *argv[]);
+
+// Density: launches idle containers up to a count and records host memory,
+// slab, supervisor RSS and launch latency as the count grows
+int bench_density(int argc, char *argv[]);
+
+// Namespace cost: launches containers with each namespace on its own and
+// compares clone, launch and teardown latency against no namespaces at all
+int bench_ns(int argc, char *argv[]);
+
+// Network: streams data and times round trips between two containers on
+// the bridge, next to the same workloads over host loopback
+int bench_net(int argc, char *argv[]);
+
+// Prints one "name p50 p90 p99 p999 max" row of a latency table
+void print_latency_row(const std::string &name, const HdrHistogram &histogram);
+
+// Prints the header matching print_latency_row()
+void print_latency_header();
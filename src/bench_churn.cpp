@@ -0,0 +1,338 @@
+#include "bench.hpp"
+#include "container.hpp"
+#include "state.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Ways a container's life can go, exercised in rotation
+enum ChurnScenario {
+    CHURN_CLEAN,              // Workload exits 0
+    CHURN_EXIT_CODE,          // Workload exits non-zero
+    CHURN_SIGNAL,             // Workload dies from a signal
+    CHURN_BAD_LIMITS,         // A cgroup write fails during setup
+    CHURN_EXEC_FAIL,          // Child fails before exec (chroot into a missing rootfs)
+    CHURN_KILLED_SUPERVISOR,  // The supervising dockher process is SIGKILLed mid-run
+    CHURN_COMMAND,            // A real "sh -c true" in the rootfs, if there is one
+    CHURN_SCENARIO_COUNT
+};
+
+static const char *const scenario_names[CHURN_SCENARIO_COUNT] = {
+    "clean", "exit-code", "signal", "bad-limits", "exec-fail", "killed-supervisor", "command"
+};
+
+// Host-side resources a leaking runtime would pile up
+struct ResourceSnapshot {
+    int cgroups = 0;     // dockher_* directories under the cgroup root
+    int mounts = 0;      // Lines in our mountinfo
+    int zombies = 0;     // Unreaped children
+    int fds = 0;         // Open descriptors
+    int states = 0;      // State files
+    long rss_kb = 0;     // Our resident set
+};
+
+static int count_entries(const std::string &path, const std::string &prefix) {
+    int count = 0;
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        return 0;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != ".." && name.compare(0, prefix.size(), prefix) == 0) {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static ResourceSnapshot snapshot() {
+    ResourceSnapshot s;
+    s.cgroups = count_entries(CGROUP_ROOT, "dockher_");
+    s.fds = count_entries("/proc/self/fd", "");
+    s.states = list_states().size();
+
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(mountinfo, line)) {
+        s.mounts++;
+    }
+
+    std::ifstream status("/proc/self/status");
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            s.rss_kb = std::stol(line.substr(6));
+        }
+    }
+
+    // Zombies: our children in state Z. The comm field may contain spaces,
+    // so parse from the closing parenthesis.
+    pid_t self = getpid();
+    DIR *proc = opendir("/proc");
+    while (dirent *entry = proc ? readdir(proc) : nullptr) {
+        std::string name = entry->d_name;
+        if (name.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        std::ifstream stat_file("/proc/" + name + "/stat");
+        std::string stat_line;
+        std::getline(stat_file, stat_line);
+        size_t paren = stat_line.rfind(')');
+        if (paren == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(stat_line.substr(paren + 2));
+        char state;
+        pid_t ppid;
+        if (fields >> state >> ppid && state == 'Z' && ppid == self) {
+            s.zombies++;
+        }
+    }
+    if (proc) {
+        closedir(proc);
+    }
+    return s;
+}
+
+// Body of the supervisor killed_supervisor() starts: launches a container
+// like "dockher run" and writes a byte to ready_fd once its workload runs
+static int supervise_once(const std::string &rootfs, int ready_fd) {
+    ContainerConfig config;
+    config.rootfs = rootfs;
+    config.limits.mem_mb = 64;
+    config.workload = []() { sleep(60); return 0; };
+    Container container;
+    if (!create_container(config, container)) {
+        return 1;
+    }
+    ContainerState state;
+    state.pid = container.pid;
+    state.supervisor = getpid();
+    state.cgroup = container.cgroup;
+    state.rootfs = rootfs;
+    save_state(state);
+    if (!start_container(container)) {
+        return 1;
+    }
+    char byte = 1;
+    write(ready_fd, &byte, 1);
+    wait_container(container);
+    return 0;
+}
+
+// Mimics "dockher run" in a separate supervisor and SIGKILLs it once the
+// workload is running. Returns true if the kill happened as planned. The
+// supervisor is a fresh exec of ourselves: the churn workers are threads,
+// and a forked child of a threaded process may only make async-signal-safe
+// calls, while launching a container allocates and prints.
+static bool killed_supervisor(const std::string &rootfs) {
+    int ready[2];
+    if (pipe2(ready, O_CLOEXEC) == -1) {
+        return false;
+    }
+    // Built before the fork, which leaves the child nothing to allocate
+    std::string fd = std::to_string(ready[1]);
+    char *const args[] = {(char *)"dockher", (char *)"bench", (char *)"churn", (char *)"--rootfs", (char *)rootfs.c_str(),
+                          (char *)"--supervise-fd", (char *)fd.c_str(), NULL};
+    pid_t supervisor = fork();
+    if (supervisor == -1) {
+        close(ready[0]);
+        close(ready[1]);
+        return false;
+    }
+    if (supervisor == 0) {
+        // Only the write end survives the exec
+        fcntl(ready[1], F_SETFD, 0);
+        execv("/proc/self/exe", args);
+        _exit(127);
+    }
+
+    close(ready[1]);
+    char byte;
+    bool started = read(ready[0], &byte, 1) == 1;
+    close(ready[0]);
+    kill(supervisor, SIGKILL);
+    waitpid(supervisor, nullptr, 0);
+    return started;
+}
+
+// Runs one scenario. Returns true if it ended the way the scenario expects.
+static bool run_scenario(ChurnScenario scenario, const std::string &rootfs, bool have_rootfs) {
+    if (scenario == CHURN_KILLED_SUPERVISOR) {
+        return killed_supervisor(rootfs);
+    }
+
+    ContainerConfig config;
+    config.rootfs = rootfs;
+    config.limits.mem_mb = 64;
+    switch (scenario) {
+    case CHURN_CLEAN:
+        config.workload = []() { return 0; };
+        break;
+    case CHURN_EXIT_CODE:
+        config.workload = []() { return 3; };
+        break;
+    case CHURN_SIGNAL:
+        // A real fault: signals merely sent to a PID namespace's init are
+        // ignored unless it installed a handler
+        config.workload = []() { *static_cast<volatile int *>(nullptr) = 0; return 0; };
+        break;
+    case CHURN_BAD_LIMITS:
+        // No host has this many CPUs, so the cpuset.cpus write fails
+        config.limits.cpuset_cpus = "65535";
+        config.workload = []() { return 0; };
+        break;
+    case CHURN_EXEC_FAIL:
+        config.rootfs = "/nonexistent-dockher-rootfs";
+        config.cmd = "true";
+        break;
+    case CHURN_COMMAND:
+        if (!have_rootfs) {
+            return true;
+        }
+        config.cmd = "true";
+        break;
+    default:
+        break;
+    }
+
+    Container container;
+    if (!create_container(config, container)) {
+        return scenario == CHURN_BAD_LIMITS;
+    }
+    if (!start_container(container)) {
+        destroy_container(container);
+        return scenario == CHURN_EXEC_FAIL;
+    }
+    int status = wait_container(container);
+    destroy_container(container);
+    switch (scenario) {
+    case CHURN_EXIT_CODE:
+        return WIFEXITED(status) && WEXITSTATUS(status) == 3;
+    case CHURN_SIGNAL:
+        return WIFSIGNALED(status);
+    default:
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+}
+
+static void print_snapshot(const std::string &label, const ResourceSnapshot &s) {
+    std::cout << std::left << std::setw(14) << label << std::right
+              << std::setw(9) << s.cgroups << std::setw(8) << s.mounts << std::setw(9) << s.zombies
+              << std::setw(6) << s.fds << std::setw(8) << s.states << std::setw(10) << s.rss_kb << std::endl;
+}
+
+// dockher bench churn --duration 60 --concurrency 4
+int bench_churn(int argc, char *argv[]) {
+    cxxopts::Options options("dockher bench churn", "Create and destroy containers at a high rate and check for leaks");
+    options.add_options()
+        ("d,duration", "How long to churn (s)", cxxopts::value<int>()->default_value("30"))
+        ("j,concurrency", "Containers in flight at once", cxxopts::value<int>()->default_value("4"))
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("rss-tolerance", "Allowed supervisor RSS growth (KB)", cxxopts::value<long>()->default_value("1024"))
+        ("h,help", "Print usage");
+    // Internal: runs one supervisor for the killed-supervisor scenario
+    options.add_options("internal")
+        ("supervise-fd", "", cxxopts::value<int>());
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << options.help({""}) << std::endl;
+        return 0;
+    }
+    if (result.count("supervise-fd")) {
+        return supervise_once(result["rootfs"].as<std::string>(), result["supervise-fd"].as<int>());
+    }
+    int duration = result["duration"].as<int>();
+    int concurrency = result["concurrency"].as<int>();
+    if (duration < 1 || concurrency < 1) {
+        std::cerr << "--duration and --concurrency must be at least 1" << std::endl;
+        return 1;
+    }
+    std::string rootfs = result["rootfs"].as<std::string>();
+    struct stat st;
+    bool have_rootfs = stat(rootfs.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+
+    // One untimed round of every scenario first, so allocator and stream
+    // buffers reach steady state before the RSS baseline is taken
+    for (int s = 0; s < CHURN_SCENARIO_COUNT; s++) {
+        run_scenario(static_cast<ChurnScenario>(s), rootfs, have_rootfs);
+    }
+    collect_garbage();
+    ResourceSnapshot before = snapshot();
+
+    std::atomic<uint64_t> next(0);
+    std::atomic<int> runs[CHURN_SCENARIO_COUNT] = {};
+    std::atomic<int> unexpected[CHURN_SCENARIO_COUNT] = {};
+    uint64_t deadline = monotonic_ns() + duration * 1000000000ull;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < concurrency; w++) {
+        workers.emplace_back([&]() {
+            while (monotonic_ns() < deadline) {
+                ChurnScenario scenario = static_cast<ChurnScenario>(next.fetch_add(1) % CHURN_SCENARIO_COUNT);
+                runs[scenario]++;
+                if (!run_scenario(scenario, rootfs, have_rootfs)) {
+                    unexpected[scenario]++;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    ResourceSnapshot churned = snapshot();
+    collect_garbage();
+    ResourceSnapshot after = snapshot();
+
+    uint64_t total = 0;
+    std::cout << "Churn: " << duration << "s, concurrency " << concurrency << std::endl;
+    std::cout << std::left << std::setw(20) << "scenario" << std::right << std::setw(8) << "runs"
+              << std::setw(12) << "unexpected" << std::endl;
+    bool failed = false;
+    for (int s = 0; s < CHURN_SCENARIO_COUNT; s++) {
+        std::cout << std::left << std::setw(20) << scenario_names[s] << std::right
+                  << std::setw(8) << runs[s] << std::setw(12) << unexpected[s]
+                  << (s == CHURN_COMMAND && !have_rootfs ? "  (skipped, no rootfs)" : "") << std::endl;
+        total += runs[s];
+        failed = failed || unexpected[s] > 0;
+    }
+    std::cout << std::fixed << std::setprecision(1) << "Rate: " << total / static_cast<double>(duration)
+              << " containers/s" << std::endl;
+
+    std::cout << "\n" << std::left << std::setw(14) << "resources" << std::right << std::setw(9) << "cgroups"
+              << std::setw(8) << "mounts" << std::setw(9) << "zombies" << std::setw(6) << "fds"
+              << std::setw(8) << "states" << std::setw(10) << "rss_kb" << std::endl;
+    print_snapshot("before", before);
+    print_snapshot("after churn", churned);
+    print_snapshot("after gc", after);
+
+    // Killed supervisors legitimately leave state and a cgroup for gc; after
+    // gc nothing may remain
+    long rss_growth = after.rss_kb - before.rss_kb;
+    if (after.cgroups > before.cgroups || after.mounts > before.mounts || after.zombies > before.zombies
+        || after.fds > before.fds || after.states > before.states) {
+        std::cout << "LEAK: resources left behind after gc" << std::endl;
+        failed = true;
+    }
+    if (rss_growth > result["rss-tolerance"].as<long>()) {
+        std::cout << "LEAK: supervisor RSS grew by " << rss_growth << " KB" << std::endl;
+        failed = true;
+    }
+    if (!failed) {
+        std::cout << "No leaks detected" << std::endl;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+#include "bench.hpp"
+#include "container.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Host-wide memory figures from /proc/meminfo, in KB
+struct HostMemory {
+    long used_kb = 0;   // MemTotal - MemAvailable
+    long slab_kb = 0;   // Slab (reclaimable and not)
+    long rss_kb = 0;    // Our own resident set
+};
+
+// Reads a "Key:   value kB" line from /proc/meminfo or /proc/self/status
+static long meminfo_field(const std::string &path, const std::string &key) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, key.size() + 1, key + ":") == 0) {
+            return std::stol(line.substr(key.size() + 1));
+        }
+    }
+    return 0;
+}
+
+static HostMemory host_memory() {
+    HostMemory m;
+    m.used_kb = meminfo_field("/proc/meminfo", "MemTotal") - meminfo_field("/proc/meminfo", "MemAvailable");
+    m.slab_kb = meminfo_field("/proc/meminfo", "Slab");
+    m.rss_kb = meminfo_field("/proc/self/status", "VmRSS");
+    return m;
+}
+
+// dockher bench density --count 1000 --step 100
+int bench_density(int argc, char *argv[]) {
+    cxxopts::Options options("dockher bench density", "Measure per-container memory and kernel overhead at scale");
+    options.add_options()
+        ("n,count", "Idle containers to launch in total", cxxopts::value<int>()->default_value("1000"))
+        ("s,step", "Report every this many containers", cxxopts::value<int>()->default_value("100"))
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("m,mem", "Memory limit of each container (MB)", cxxopts::value<long long>()->default_value("16"))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    int count = result["count"].as<int>();
+    int step = result["step"].as<int>();
+    if (count < 1 || step < 1) {
+        std::cerr << "--count and --step must be at least 1" << std::endl;
+        return 1;
+    }
+
+    // Every container holds a pidfd open in the supervisor
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    // Idle workload: signals sent to a PID namespace's init without a
+    // handler are ignored, so only the SIGKILL at teardown ends it
+    ContainerConfig config;
+    config.rootfs = result["rootfs"].as<std::string>();
+    config.limits.mem_mb = result["mem"].as<long long>();
+    config.workload = []() {
+        for (;;) {
+            pause();
+        }
+        return 0;
+    };
+
+    std::vector<Container> containers;
+    containers.reserve(count);
+    HostMemory baseline = host_memory();
+
+    std::cout << "Density: up to " << count << " idle containers" << std::endl;
+    std::cout << std::setw(7) << "count" << std::setw(12) << "launch p50" << std::setw(12) << "launch p99"
+              << std::setw(12) << "host MB" << std::setw(12) << "KB/ctr" << std::setw(10) << "slab MB"
+              << std::setw(13) << "slab KB/ctr" << std::setw(12) << "dockher MB" << std::endl;
+    HdrHistogram launch;
+    int failures = 0;
+    while (static_cast<int>(containers.size()) < count) {
+        containers.emplace_back();
+        Container &container = containers.back();
+        uint64_t start = monotonic_ns();
+        if (!create_container(config, container) || !start_container(container)) {
+            destroy_container(container);
+            containers.pop_back();
+            // Usually a host limit (pid_max, memory); stop rather than spin
+            if (++failures > 10) {
+                std::cerr << "Too many failed launches, stopping at " << containers.size() << std::endl;
+                break;
+            }
+            continue;
+        }
+        launch.record(monotonic_ns() - start);
+
+        int n = containers.size();
+        if (n % step == 0 || n == count) {
+            HostMemory now = host_memory();
+            long host_kb = now.used_kb - baseline.used_kb;
+            long slab_kb = now.slab_kb - baseline.slab_kb;
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(7) << n
+                      << std::setw(12) << format_ns(launch.percentile(50))
+                      << std::setw(12) << format_ns(launch.percentile(99))
+                      << std::setw(12) << host_kb / 1024.0
+                      << std::setw(12) << static_cast<double>(host_kb) / n
+                      << std::setw(10) << slab_kb / 1024.0
+                      << std::setw(13) << static_cast<double>(slab_kb) / n
+                      << std::setw(12) << now.rss_kb / 1024.0 << std::endl;
+            // Each row shows launch latency at that density, not since the start
+            launch = HdrHistogram();
+        }
+    }
+
+    uint64_t teardown_start = monotonic_ns();
+    for (Container &container : containers) {
+        destroy_container(container);
+    }
+    uint64_t teardown = monotonic_ns() - teardown_start;
+    std::cout << "Teardown of " << containers.size() << " containers: " << format_ns(teardown);
+    if (!containers.empty()) {
+        std::cout << " (" << format_ns(teardown / containers.size()) << " each)";
+    }
+    std::cout << std::endl;
+    return failures ? 1 : 0;
+}
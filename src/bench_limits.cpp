@@ -0,0 +1,282 @@
+#include "bench.hpp"
+#include "container.hpp"
+#include "perf.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// Written by the workload inside the container, read by the benchmark.
+// Lives in a MAP_SHARED page created before clone.
+struct WorkloadReport {
+    volatile uint64_t max_stall_ns;     // Longest gap the burner saw between iterations
+    volatile uint64_t bytes_touched;    // Memory the allocator has faulted in so far
+};
+
+// Spins for duration_ns, timing each small chunk of work. Gaps much longer
+// than a chunk are time spent throttled (or preempted).
+static int cpu_burner(WorkloadReport *report, uint64_t duration_ns) {
+    uint64_t start = monotonic_ns();
+    uint64_t last = start;
+    volatile uint64_t sink = 0;
+    while (last - start < duration_ns) {
+        for (int i = 0; i < 1000; i++) {
+            sink = sink + i;
+        }
+        uint64_t now = monotonic_ns();
+        if (now - last > report->max_stall_ns) {
+            report->max_stall_ns = now - last;
+        }
+        last = now;
+    }
+    return 0;
+}
+
+// Faults in memory at a fixed rate until the OOM killer stops it
+static int memory_allocator(WorkloadReport *report, long rate_mb_s) {
+    const size_t chunk = 1024 * 1024;
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t start = monotonic_ns();
+    for (;;) {
+        char *block = static_cast<char *>(mmap(nullptr, chunk, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (block == MAP_FAILED) {
+            return 1;
+        }
+        for (size_t offset = 0; offset < chunk; offset += page_size) {
+            block[offset] = 1;
+        }
+        report->bytes_touched = report->bytes_touched + chunk;
+
+        // Pace to the requested rate
+        uint64_t due = start + (report->bytes_touched / chunk) * 1000000000ull / rate_mb_s;
+        uint64_t now = monotonic_ns();
+        if (due > now) {
+            usleep((due - now) / 1000);
+        }
+    }
+}
+
+// Parses a comma-separated list of integers given to option, reporting the
+// first item that is not one
+static bool parse_int_list(const std::string &option, const std::string &list, std::vector<int> &values) {
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        char *end = nullptr;
+        errno = 0;
+        long value = strtol(item.c_str(), &end, 10);
+        if (*end != '\0' || errno == ERANGE || value < INT_MIN || value > INT_MAX) {
+            std::cerr << "Invalid value \"" << item << "\" in --" << option << std::endl;
+            return false;
+        }
+        values.push_back(value);
+    }
+    return true;
+}
+
+// Runs one CPU burner under cpu_pct/period_us and prints a result row
+static bool measure_cpu(const std::string &rootfs, int cpu_pct, int period_us, long duration_ms, long sample_ms) {
+    WorkloadReport *report = static_cast<WorkloadReport *>(
+        mmap(nullptr, sizeof(WorkloadReport), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if (report == MAP_FAILED) {
+        return false;
+    }
+    report->max_stall_ns = 0;
+
+    ContainerConfig config;
+    config.rootfs = rootfs;
+    config.limits.cpu_pct = cpu_pct;
+    config.limits.cpu_period_us = period_us;
+    // Pin to one CPU so every sample measures the same core
+    config.limits.cpuset_cpus = std::to_string(online_cpus().back());
+    uint64_t duration_ns = duration_ms * 1000000ull;
+    config.workload = [report, duration_ns]() { return cpu_burner(report, duration_ns); };
+
+    Container container;
+    if (!create_container(config, container) || !start_container(container)) {
+        destroy_container(container);
+        munmap(report, sizeof(WorkloadReport));
+        return false;
+    }
+
+    // Sample usage every sample_ms; the spread of the per-sample share is the jitter
+    std::string cpu_stat = container.cgroup + "/cpu.stat";
+    std::vector<double> shares;
+    long long first_usage = read_cgroup_stat(cpu_stat, "usage_usec");
+    long long last_usage = first_usage;
+    uint64_t first_time = monotonic_ns();
+    uint64_t last_time = first_time;
+    long long throttled = 0, throttled_us = 0;
+    while (true) {
+        usleep(sample_ms * 1000);
+        if (waitpid(container.pid, nullptr, WNOHANG) != 0) {
+            container.reaped = true;
+            break;
+        }
+        long long usage = read_cgroup_stat(cpu_stat, "usage_usec");
+        uint64_t now = monotonic_ns();
+        shares.push_back(100.0 * (usage - last_usage) * 1000 / (now - last_time));
+        throttled = read_cgroup_stat(cpu_stat, "nr_throttled");
+        throttled_us = read_cgroup_stat(cpu_stat, "throttled_usec");
+        last_usage = usage;
+        last_time = now;
+    }
+    destroy_container(container);
+
+    double achieved = last_time > first_time ? 100.0 * (last_usage - first_usage) * 1000 / (last_time - first_time) : 0;
+    double mean = 0, variance = 0;
+    for (double share : shares) {
+        mean += share;
+    }
+    mean = shares.empty() ? 0 : mean / shares.size();
+    for (double share : shares) {
+        variance += (share - mean) * (share - mean);
+    }
+    double jitter = shares.size() > 1 ? std::sqrt(variance / (shares.size() - 1)) : 0;
+    int target = cpu_pct == 0 ? 100 : cpu_pct;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << std::setw(7) << (std::to_string(cpu_pct) + "%")
+              << std::setw(10) << format_ns(period_us * 1000LL)
+              << std::setw(11) << achieved << "%"
+              << std::setw(9) << (achieved - target)
+              << std::setw(11) << jitter
+              << std::setw(11) << (throttled >= 0 ? std::to_string(throttled) : "n/a")
+              << std::setw(13) << (throttled_us >= 0 ? format_ns(throttled_us * 1000) : "n/a")
+              << std::setw(11) << format_ns(report->max_stall_ns) << std::endl;
+    munmap(report, sizeof(WorkloadReport));
+    return true;
+}
+
+// Runs one allocator under mem_mb until it is OOM killed and prints a result row
+static bool measure_memory(const std::string &rootfs, int mem_mb, long rate_mb_s, long timeout_ms) {
+    WorkloadReport *report = static_cast<WorkloadReport *>(
+        mmap(nullptr, sizeof(WorkloadReport), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if (report == MAP_FAILED) {
+        return false;
+    }
+    report->bytes_touched = 0;
+
+    ContainerConfig config;
+    config.rootfs = rootfs;
+    config.limits.mem_mb = mem_mb;
+    config.workload = [report, rate_mb_s]() { return memory_allocator(report, rate_mb_s); };
+
+    Container container;
+    if (!create_container(config, container)) {
+        munmap(report, sizeof(WorkloadReport));
+        return false;
+    }
+    // Swap would let the allocator run on past memory.max
+    write_to_file(container.cgroup + "/memory.swap.max", "0");
+    if (!start_container(container)) {
+        destroy_container(container);
+        munmap(report, sizeof(WorkloadReport));
+        return false;
+    }
+
+    // Give up after timeout_ms in case the limit is never enforced
+    int status = 0;
+    bool killed = false;
+    while (waitpid(container.pid, &status, WNOHANG) == 0) {
+        if (monotonic_ns() - container.exec_ns > timeout_ms * 1000000ull) {
+            kill(container.pid, SIGKILL);
+            killed = true;
+        }
+        usleep(1000);
+    }
+    container.reaped = true;
+    uint64_t time_to_oom = monotonic_ns() - container.exec_ns;
+    long long peak = read_cgroup_value(container.cgroup + "/memory.peak");
+    long long oom_kills = read_cgroup_stat(container.cgroup + "/memory.events", "oom_kill");
+    destroy_container(container);
+
+    double limit_bytes = mem_mb * 1024.0 * 1024.0;
+    std::cout << std::fixed << std::setprecision(2)
+              << std::setw(9) << (std::to_string(mem_mb) + "MB")
+              << std::setw(11) << (peak >= 0 ? std::to_string(peak / (1024 * 1024)) + "MB" : "n/a")
+              << std::setw(12) << (peak >= 0 ? peak / limit_bytes : 0)
+              << std::setw(12) << (std::to_string(report->bytes_touched / (1024 * 1024)) + "MB")
+              << std::setw(13) << (killed ? "timeout" : format_ns(time_to_oom))
+              << std::setw(11) << (oom_kills >= 0 ? std::to_string(oom_kills) : "n/a") << std::endl;
+    munmap(report, sizeof(WorkloadReport));
+    return true;
+}
+
+// dockher bench limits --cpu-values 10,50 --periods 10000,100000 --mem-values 64,128
+int bench_limits(int argc, char *argv[]) {
+    cxxopts::Options options("dockher bench limits", "Measure how closely cpu.max and memory.max are honoured");
+    options.add_options()
+        ("cpu-values", "CPU limits to sweep (%)", cxxopts::value<std::string>()->default_value("10,25,50,75,100"))
+        ("periods", "cpu.max periods to sweep (us)", cxxopts::value<std::string>()->default_value("10000,100000,1000000"))
+        ("duration", "How long each CPU burner runs (ms)", cxxopts::value<long>()->default_value("3000"))
+        ("sample", "CPU usage sampling interval for jitter (ms)", cxxopts::value<long>()->default_value("100"))
+        ("mem-values", "Memory limits to sweep (MB)", cxxopts::value<std::string>()->default_value("64,128,256"))
+        ("alloc-rate", "Memory allocator fault-in rate (MB/s)", cxxopts::value<long>()->default_value("256"))
+        ("oom-timeout", "Give up waiting for an OOM kill after this long (ms)", cxxopts::value<long>()->default_value("30000"))
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    std::string rootfs = result["rootfs"].as<std::string>();
+    long duration_ms = result["duration"].as<long>();
+    long sample_ms = result["sample"].as<long>();
+    long rate = result["alloc-rate"].as<long>();
+    if (duration_ms <= 0 || sample_ms <= 0 || rate <= 0) {
+        std::cerr << "--duration, --sample and --alloc-rate must be positive" << std::endl;
+        return 1;
+    }
+
+    std::vector<int> periods, cpu_values, mem_values;
+    if (!parse_int_list("periods", result["periods"].as<std::string>(), periods) ||
+        !parse_int_list("cpu-values", result["cpu-values"].as<std::string>(), cpu_values) ||
+        !parse_int_list("mem-values", result["mem-values"].as<std::string>(), mem_values)) {
+        return 1;
+    }
+
+    int failures = 0;
+    std::cout << "CPU limit accuracy (" << duration_ms << "ms per run, " << sample_ms << "ms samples)" << std::endl;
+    std::cout << std::setw(7) << "limit" << std::setw(10) << "period" << std::setw(12) << "achieved"
+              << std::setw(9) << "error" << std::setw(11) << "jitter(sd)" << std::setw(11) << "throttled"
+              << std::setw(13) << "throttled_t" << std::setw(11) << "max stall" << std::endl;
+    for (int period : periods) {
+        for (int cpu : cpu_values) {
+            Limits check;
+            check.cpu_pct = cpu;
+            check.cpu_period_us = period;
+            if (!validate_limits(check) || !measure_cpu(rootfs, cpu, period, duration_ms, sample_ms)) {
+                failures++;
+            }
+        }
+    }
+
+    std::cout << "\nMemory limit enforcement (" << rate << " MB/s fault-in rate, no swap)" << std::endl;
+    std::cout << std::setw(9) << "limit" << std::setw(11) << "peak" << std::setw(12) << "peak/limit"
+              << std::setw(12) << "touched" << std::setw(13) << "time-to-OOM" << std::setw(11) << "oom_kills" << std::endl;
+    for (int mem : mem_values) {
+        if (mem <= 0 || !measure_memory(rootfs, mem, rate, result["oom-timeout"].as<long>())) {
+            failures++;
+        }
+    }
+
+    if (failures) {
+        std::cout << "Failures: " << failures << std::endl;
+    }
+    return failures ? 1 : 0;
+}
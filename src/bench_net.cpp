@@ -0,0 +1,258 @@
+#include "bench.hpp"
+#include "container.hpp"
+#include "net.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// Port the server workload listens on
+#define BENCH_NET_PORT 5201
+
+// Most round trips one run can record
+#define BENCH_NET_MAX_ROUNDS 100000
+
+// Shared between the benchmark and the workloads in both containers.
+// Lives in a MAP_SHARED mapping created before clone.
+struct NetReport {
+    volatile uint32_t server_addr;   // Set by the benchmark before the client starts
+    volatile uint64_t bytes;         // Streamed by the client
+    volatile uint64_t stream_ns;     // From the first write until the server closed
+    volatile int rounds;             // Round trips recorded in rtt_ns
+    volatile uint64_t rtt_ns[BENCH_NET_MAX_ROUNDS];
+};
+
+// Accepts one stream connection and reads it to the end, then one
+// connection it echoes every byte back on
+static int net_server() {
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BENCH_NET_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1 || listen(listener, 4) == -1) {
+        return 1;
+    }
+
+    static char buffer[256 * 1024];
+    int stream = accept(listener, nullptr, nullptr);
+    while (read(stream, buffer, sizeof(buffer)) > 0) {
+    }
+    close(stream);
+
+    int echo = accept(listener, nullptr, nullptr);
+    setsockopt(echo, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    char byte;
+    while (read(echo, &byte, 1) == 1 && write(echo, &byte, 1) == 1) {
+    }
+    close(echo);
+    close(listener);
+    return 0;
+}
+
+// Connects to the server, retrying while it is still starting up
+static int connect_server(uint32_t server_addr) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BENCH_NET_PORT);
+    addr.sin_addr.s_addr = server_addr;
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(1000);
+    }
+    return -1;
+}
+
+// Streams chunk-sized writes for duration_ns, then times round trips of
+// one byte each
+static int net_client(NetReport *report, uint64_t duration_ns, size_t chunk, int rounds) {
+    static char buffer[1024 * 1024];
+    int stream = connect_server(report->server_addr);
+    if (stream == -1) {
+        return 1;
+    }
+    uint64_t start = monotonic_ns();
+    while (monotonic_ns() - start < duration_ns) {
+        ssize_t n = write(stream, buffer, chunk);
+        if (n <= 0) {
+            return 1;
+        }
+        report->bytes = report->bytes + n;
+    }
+    // The server closes once it has read everything we sent
+    shutdown(stream, SHUT_WR);
+    char byte;
+    read(stream, &byte, 1);
+    report->stream_ns = monotonic_ns() - start;
+    close(stream);
+
+    int echo = connect_server(report->server_addr);
+    if (echo == -1) {
+        return 1;
+    }
+    int on = 1;
+    setsockopt(echo, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    for (int i = 0; i < rounds; i++) {
+        uint64_t sent = monotonic_ns();
+        if (write(echo, &byte, 1) != 1 || read(echo, &byte, 1) != 1) {
+            return 1;
+        }
+        report->rtt_ns[i] = monotonic_ns() - sent;
+        report->rounds = i + 1;
+    }
+    close(echo);
+    return 0;
+}
+
+static void print_net_row(const std::string &name, const NetReport *report) {
+    HdrHistogram rtt;
+    for (int i = 0; i < report->rounds; i++) {
+        rtt.record(report->rtt_ns[i]);
+    }
+    double gbits = report->stream_ns ? report->bytes * 8.0 / report->stream_ns : 0;
+    std::cout << std::left << std::setw(16) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(2) << gbits
+              << std::setw(11) << format_ns(rtt.percentile(50))
+              << std::setw(11) << format_ns(rtt.percentile(99))
+              << std::setw(11) << format_ns(rtt.percentile(99.9)) << std::endl;
+}
+
+// Launches the workload in a container attached to the bridge, and returns its address
+static bool launch_attached(const ContainerConfig &config, const NetConfig &net, Container &container,
+                            NetEndpoint &endpoint) {
+    if (!create_container(config, container)) {
+        return false;
+    }
+    int netns_fd = open(("/proc/" + std::to_string(container.pid) + "/ns/net").c_str(), O_RDONLY | O_CLOEXEC);
+    bool ok = netns_fd != -1 && attach_network(container.pid, netns_fd, net, endpoint);
+    if (netns_fd != -1) {
+        close(netns_fd);
+    }
+    if (!ok || !start_container(container)) {
+        destroy_container(container);
+        detach_network(endpoint);
+        return false;
+    }
+    return true;
+}
+
+// dockher bench net --duration 3 --rounds 10000
+int bench_net(int argc, char *argv[]) {
+    cxxopts::Options options("dockher bench net", "Measure throughput and latency between two containers on the bridge");
+    options.add_options()
+        ("d,duration", "Seconds to stream data for", cxxopts::value<double>()->default_value("3"))
+        ("rounds", "One-byte round trips to time", cxxopts::value<int>()->default_value("10000"))
+        ("chunk", "Size of each write while streaming (KB)", cxxopts::value<int>()->default_value("128"))
+        ("subnet", "Subnet of the bridge network", cxxopts::value<std::string>()->default_value(NET_DEFAULT_SUBNET))
+        ("mtu", "MTU of the containers' links", cxxopts::value<int>()->default_value(std::to_string(NET_DEFAULT_MTU)))
+        ("no-gro", "Disable generic receive offload")
+        ("no-gso", "Disable generic segmentation offload")
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    uint64_t duration_ns = result["duration"].as<double>() * 1e9;
+    int rounds = result["rounds"].as<int>();
+    size_t chunk = result["chunk"].as<int>() * 1024;
+    if (rounds < 1 || rounds > BENCH_NET_MAX_ROUNDS || chunk < 1 || chunk > 1024 * 1024) {
+        std::cerr << "--rounds must be between 1 and " << BENCH_NET_MAX_ROUNDS << " and --chunk between 1 and 1024" << std::endl;
+        return 1;
+    }
+    NetConfig net;
+    net.subnet = result["subnet"].as<std::string>();
+    if (!validate_subnet(net.subnet)) {
+        return 1;
+    }
+    net.mtu = result["mtu"].as<int>();
+    net.gro = !result["no-gro"].as<bool>();
+    net.gso = !result["no-gso"].as<bool>();
+
+    std::cout << "Network: " << result["duration"].as<double>() << "s stream of " << chunk / 1024 << " KB writes, "
+              << rounds << " round trips, MTU " << net.mtu << ", GRO " << (net.gro ? "on" : "off")
+              << ", GSO " << (net.gso ? "on" : "off") << std::endl;
+    std::cout << std::left << std::setw(16) << "path" << std::right << std::setw(10) << "Gbit/s"
+              << std::setw(11) << "rtt p50" << std::setw(11) << "rtt p99" << std::setw(11) << "rtt p999" << std::endl;
+
+    // Baseline: the same workloads as threads of ours over host loopback.
+    // They are joined before any clone, so the children inherit no held locks.
+    NetReport *reports[2];
+    for (NetReport *&report : reports) {
+        report = static_cast<NetReport *>(mmap(nullptr, sizeof(NetReport), PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        if (report == MAP_FAILED) {
+            std::cerr << "Failed to map the workload report" << std::endl;
+            return 1;
+        }
+    }
+    NetReport *loopback = reports[0];
+    loopback->server_addr = htonl(INADDR_LOOPBACK);
+    std::thread server(net_server);
+    int loopback_status = net_client(loopback, duration_ns, chunk, rounds);
+    server.join();
+    if (loopback_status != 0) {
+        std::cerr << "Loopback run failed" << std::endl;
+        return 1;
+    }
+    print_net_row("host loopback", loopback);
+
+    // Then a server and a client container, each with its own network namespace
+    NetReport *bridge = reports[1];
+    ContainerConfig server_config;
+    server_config.rootfs = result["rootfs"].as<std::string>();
+    server_config.limits.mem_mb = 256;
+    server_config.namespaces |= CLONE_NEWNET;
+    server_config.workload = []() { return net_server(); };
+    ContainerConfig client_config = server_config;
+    client_config.workload = [=]() { return net_client(bridge, duration_ns, chunk, rounds); };
+
+    Container server_container, client_container;
+    NetEndpoint server_endpoint, client_endpoint;
+    if (!launch_attached(server_config, net, server_container, server_endpoint)) {
+        return 1;
+    }
+    in_addr server_addr;
+    inet_pton(AF_INET, server_endpoint.address.c_str(), &server_addr);
+    bridge->server_addr = server_addr.s_addr;
+    if (!launch_attached(client_config, net, client_container, client_endpoint)) {
+        destroy_container(server_container);
+        detach_network(server_endpoint);
+        return 1;
+    }
+    int client_status = wait_container(client_container);
+    int server_status = wait_container(server_container);
+    destroy_container(client_container);
+    destroy_container(server_container);
+    detach_network(client_endpoint);
+    detach_network(server_endpoint);
+    if (client_status != 0 || server_status != 0) {
+        std::cerr << "Bridge run failed" << std::endl;
+        return 1;
+    }
+    print_net_row("bridge (veth)", bridge);
+
+    double share = loopback->bytes && bridge->stream_ns
+        ? (static_cast<double>(bridge->bytes) / bridge->stream_ns) / (static_cast<double>(loopback->bytes) / loopback->stream_ns)
+        : 0;
+    std::cout << "Bridge throughput: " << std::fixed << std::setprecision(1) << share * 100 << "% of loopback" << std::endl;
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "bench.hpp"
+#include "container.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+
+// Latencies of one namespace set
+struct NsResults {
+    HdrHistogram clone;     // clone() plus any id mapping, from the "clone" span
+    HdrHistogram launch;    // create_container() to exec
+    HdrHistogram teardown;  // Reaping and destroying the exited container
+    uint64_t elapsed = 0;
+    int failures = 0;
+};
+
+static bool measure_ns(const ContainerConfig &config, NsResults *results) {
+    Container container;
+    if (!create_container(config, container)) {
+        return false;
+    }
+    if (!start_container(container)) {
+        destroy_container(container);
+        return false;
+    }
+    uint64_t teardown_start = monotonic_ns();
+    int status = wait_container(container);
+    destroy_container(container);
+    uint64_t teardown_end = monotonic_ns();
+
+    if (results) {
+        for (const TraceSpan &span : container.spans) {
+            if (span.name == "clone") {
+                results->clone.record(span.end_ns - span.start_ns);
+            }
+        }
+        results->launch.record(container.exec_ns - container.created_ns);
+        results->teardown.record(teardown_end - teardown_start);
+    }
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// dockher bench ns --count 200
+int bench_ns(int argc, char *argv[]) {
+    cxxopts::Options options("dockher bench ns", "Measure the creation and teardown cost of each namespace");
+    options.add_options()
+        ("n,count", "Containers to launch per namespace set", cxxopts::value<int>()->default_value("200"))
+        ("warmup", "Containers launched before measuring each set", cxxopts::value<int>()->default_value("5"))
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    int count = result["count"].as<int>();
+    if (count < 1) {
+        std::cerr << "--count must be at least 1" << std::endl;
+        return 1;
+    }
+
+    // Each namespace on its own, then the default set and all of them. The
+    // built-in workload exits at once, so only the runtime is measured.
+    // Network namespaces are freed by a kernel worker after the exit, so
+    // part of their cost shows in the launches per second, not teardown.
+    const char *const sets[] = {"none", "pid", "mnt", "net", "ipc", "uts", "user", "cgroup", "time",
+                                "pid,mnt", "pid,mnt,net,ipc,uts,user,cgroup,time"};
+    ContainerConfig config;
+    config.rootfs = result["rootfs"].as<std::string>();
+    config.limits.mem_mb = 64;
+    config.workload = []() { return 0; };
+
+    std::cout << "Namespace cost: " << count << " containers per set, one at a time" << std::endl;
+    std::cout << std::left << std::setw(40) << "namespaces" << std::right
+              << std::setw(11) << "clone p50" << std::setw(11) << "clone p99"
+              << std::setw(12) << "launch p50" << std::setw(12) << "launch p99"
+              << std::setw(14) << "teardown p50" << std::setw(14) << "teardown p99"
+              << std::setw(12) << "+launch" << std::setw(10) << "per sec" << std::endl;
+
+    int failures = 0;
+    int64_t baseline = 0;
+    for (const char *set : sets) {
+        if (!parse_namespaces(set, config.namespaces)) {
+            return 1;
+        }
+        for (int i = 0; i < result["warmup"].as<int>(); i++) {
+            measure_ns(config, nullptr);
+        }
+        NsResults r;
+        uint64_t start = monotonic_ns();
+        for (int i = 0; i < count; i++) {
+            if (!measure_ns(config, &r)) {
+                r.failures++;
+            }
+        }
+        r.elapsed = monotonic_ns() - start;
+        failures += r.failures;
+        if (r.launch.count() == 0) {
+            std::cout << std::left << std::setw(40) << set << "  all launches failed" << std::endl;
+            continue;
+        }
+
+        // Extra launch latency over sharing every namespace with the host
+        int64_t median = r.launch.percentile(50);
+        if (baseline == 0) {
+            baseline = median;
+        }
+        int64_t extra = median - baseline;
+        std::cout << std::left << std::setw(40) << set << std::right
+                  << std::setw(11) << format_ns(r.clone.percentile(50))
+                  << std::setw(11) << format_ns(r.clone.percentile(99))
+                  << std::setw(12) << format_ns(median)
+                  << std::setw(12) << format_ns(r.launch.percentile(99))
+                  << std::setw(14) << format_ns(r.teardown.percentile(50))
+                  << std::setw(14) << format_ns(r.teardown.percentile(99))
+                  << std::setw(12) << (extra < 0 ? "-" + format_ns(-extra) : "+" + format_ns(extra))
+                  << std::setw(10) << std::fixed << std::setprecision(1) << count / (r.elapsed / 1e9);
+        if (r.failures) {
+            std::cout << "  (" << r.failures << " failed)";
+        }
+        std::cout << std::endl;
+    }
+    return failures ? 1 : 0;
+}
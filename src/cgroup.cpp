@@ -0,0 +1,239 @@
+#include "cgroup.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <utility>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool write_to_file(const std::string &path, const std::string &value) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open: " << path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    file << value;
+    // cgroup files report invalid values on the write itself, which the
+    // stream only surfaces when flushed
+    file.flush();
+    if (!file) {
+        std::cerr << "Failed to write \"" << value << "\" to: " << path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+bool read_file(const std::string &path, std::string &value) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    value = buffer.str();
+    while (!value.empty() && value.back() == '\n') {
+        value.pop_back();
+    }
+    return true;
+}
+
+void enable_controllers(const std::string &parent) {
+    // Written one at a time: a single unavailable controller fails the whole write
+    for (const char *controller : {"+cpu", "+memory", "+cpuset", "+io", "+pids", "+hugetlb"}) {
+        std::ofstream file(parent + "/cgroup.subtree_control");
+        if (file.is_open()) {
+            file << controller;
+        }
+    }
+}
+
+bool create_cgroup(const std::string &path) {
+    if (mkdir(path.c_str(), 0755) == -1 && errno != EEXIST) {
+        std::cerr << "Failed to create cgroup: " << path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void remove_cgroup(const std::string &path) {
+    rmdir(path.c_str());
+}
+
+bool kill_cgroup(const std::string &path, long timeout_ms) {
+    std::ofstream kill_file(path + "/cgroup.kill");
+    if (kill_file.is_open()) {
+        kill_file << "1";
+        kill_file.flush();
+    }
+    for (long waited = 0; ; waited++) {
+        std::ifstream procs(path + "/cgroup.procs");
+        pid_t pid;
+        bool empty = true;
+        while (procs >> pid) {
+            empty = false;
+            if (!kill_file) {
+                kill(pid, SIGKILL);
+            }
+        }
+        if (empty) {
+            return true;
+        }
+        if (waited >= timeout_ms) {
+            return false;
+        }
+        usleep(1000);
+    }
+}
+
+long long hugepage_bytes(const std::string &size) {
+    size_t digits = size.find_first_not_of("0123456789");
+    if (digits == 0 || digits == std::string::npos) {
+        return -1;
+    }
+    errno = 0;
+    long long count = strtoll(size.c_str(), nullptr, 10);
+    std::string unit = size.substr(digits);
+    long long scale = unit == "KB" ? 1024LL : unit == "MB" ? 1024LL * 1024 : unit == "GB" ? 1024LL * 1024 * 1024 : 0;
+    if (errno == ERANGE || scale == 0 || count > LLONG_MAX / scale) {
+        return -1;
+    }
+    return count * scale;
+}
+
+bool validate_limits(const Limits &limits) {
+    if (limits.mem_mb != -1 && limits.mem_mb <= 0) {
+        std::cerr << "Memory limit must be a positive number of MB" << std::endl;
+        return false;
+    }
+    if (limits.cpu_pct != -1 && (limits.cpu_pct < 0 || limits.cpu_pct > 100)) {
+        std::cerr << "CPU limit must be between 0 and 100 (%)" << std::endl;
+        return false;
+    }
+    if (limits.cpu_period_us < 1000 || limits.cpu_period_us > 1000000) {
+        std::cerr << "CPU period must be between 1000 and 1000000 (us)" << std::endl;
+        return false;
+    }
+    if (limits.hugetlb_pages != -1 && (limits.hugetlb_pages < 0 || hugepage_bytes(limits.hugetlb_size) == -1)) {
+        std::cerr << "Huge pages must be a count of pages of a size like 2MB or 1GB" << std::endl;
+        return false;
+    }
+    for (int weight : {limits.cpu_weight, limits.io_weight}) {
+        if (weight != -1 && (weight < 1 || weight > 10000)) {
+            std::cerr << "Weights must be between 1 and 10000" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Works out what to write back to undo writing new_value over old_value
+static std::string restore_value(const std::string &name, const std::string &new_value, const std::string &old_value) {
+    if (name == "io.max") {
+        // io.max lists one line per configured device; restore only ours
+        std::string device = new_value.substr(0, new_value.find(' '));
+        std::istringstream lines(old_value);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, device.size() + 1, device + " ") == 0) {
+                return line;
+            }
+        }
+        return device + " rbps=max wbps=max riops=max wiops=max";
+    }
+    if (name == "io.weight") {
+        // Per-device overrides follow the "default N" line and are left alone
+        return old_value.substr(0, old_value.find('\n'));
+    }
+    // An empty cpuset file means "inherit from parent"; a bare newline resets it
+    return old_value.empty() ? "\n" : old_value;
+}
+
+bool apply_limits(const std::string &path, const Limits &limits) {
+    if (!validate_limits(limits)) {
+        return false;
+    }
+
+    // Collect every file to write first so a failure part-way through can be rolled back
+    std::vector<std::pair<std::string, std::string>> writes;
+    if (!limits.cpuset_mems.empty()) {
+        writes.emplace_back("cpuset.mems", limits.cpuset_mems);
+    }
+    if (!limits.cpuset_cpus.empty()) {
+        writes.emplace_back("cpuset.cpus", limits.cpuset_cpus);
+    }
+    if (limits.cpu_pct != -1) {
+        // Example: "50000 100000" = 50ms out of every 100ms => 50% CPU
+        // If cpu_pct is 0, allow max cpu allocation
+        long long quota_us = (static_cast<long long>(limits.cpu_pct) * limits.cpu_period_us) / 100;
+        writes.emplace_back("cpu.max", limits.cpu_pct == 0
+            ? "max " + std::to_string(limits.cpu_period_us)
+            : std::to_string(quota_us) + " " + std::to_string(limits.cpu_period_us));
+    }
+    if (limits.mem_mb != -1) {
+        writes.emplace_back("memory.max", std::to_string(limits.mem_mb * 1024 * 1024));
+    }
+    if (!limits.io_max.empty()) {
+        writes.emplace_back("io.max", limits.io_max);
+    }
+    if (limits.hugetlb_pages != -1) {
+        writes.emplace_back("hugetlb." + limits.hugetlb_size + ".max",
+                            std::to_string(limits.hugetlb_pages * hugepage_bytes(limits.hugetlb_size)));
+    }
+    if (limits.cpu_weight != -1) {
+        writes.emplace_back("cpu.weight", std::to_string(limits.cpu_weight));
+    }
+    if (limits.io_weight != -1) {
+        writes.emplace_back("io.weight", "default " + std::to_string(limits.io_weight));
+    }
+
+    // Remember the previous value of each file so a failed write can be undone
+    std::vector<std::pair<std::string, std::string>> written;
+    for (const auto &w : writes) {
+        std::string file = path + "/" + w.first;
+        std::string old_value;
+        if (!read_file(file, old_value)) {
+            std::cerr << "Failed to read: " << file << " — " << strerror(errno) << std::endl;
+        } else if (write_to_file(file, w.second)) {
+            written.emplace_back(file, restore_value(w.first, w.second, old_value));
+            continue;
+        }
+
+        // Roll back in reverse order
+        for (auto it = written.rbegin(); it != written.rend(); ++it) {
+            write_to_file(it->first, it->second);
+        }
+        return false;
+    }
+    return true;
+}
+
+long long read_cgroup_stat(const std::string &file, const std::string &key) {
+    std::ifstream in(file);
+    std::string name;
+    long long value;
+    while (in >> name >> value) {
+        if (name == key) {
+            return value;
+        }
+    }
+    return -1;
+}
+
+long long read_cgroup_value(const std::string &file) {
+    std::string value;
+    if (!read_file(file, value) || value.empty() || value == "max") {
+        return -1;
+    }
+    char *end = nullptr;
+    errno = 0;
+    long long number = strtoll(value.c_str(), &end, 10);
+    return end == value.c_str() || errno == ERANGE ? -1 : number;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+
+// Root of the unified cgroup v2 hierarchy
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+// Resource limits applied to a container's cgroup.
+// Fields left at their "unset" value are not written.
+struct Limits {
+    long long mem_mb = -1;        // memory.max in MB, -1 = unset
+    int cpu_pct = -1;             // cpu.max as a percentage of one CPU, 0 = max, -1 = unset
+    int cpu_period_us = 100000;   // cpu.max period (100ms default)
+    std::string cpuset_cpus;      // cpuset.cpus, e.g. "0-3,6"
+    std::string cpuset_mems;      // cpuset.mems, e.g. "0"
+    std::string io_max;           // io.max line, e.g. "8:0 rbps=1048576 wbps=max"
+    int cpu_weight = -1;          // cpu.weight (1-10000, default 100), -1 = unset
+    int io_weight = -1;           // io.weight default (1-10000, default 100), -1 = unset
+    long long hugetlb_pages = -1;     // hugetlb.<size>.max in huge pages, -1 = unset
+    std::string hugetlb_size = "2MB"; // Huge page size, named as the hugetlb controller does
+};
+
+// Writes value to path. Prints the error and returns false on failure.
+bool write_to_file(const std::string &path, const std::string &value);
+
+// Reads the whole file into value (trailing newline stripped)
+bool read_file(const std::string &path, std::string &value);
+
+// Best-effort enable of the controllers dockher uses in parent's subtree_control
+void enable_controllers(const std::string &parent);
+
+// Creates the cgroup directory. Returns false if it could not be created.
+bool create_cgroup(const std::string &path);
+
+// Removes the cgroup directory
+void remove_cgroup(const std::string &path);
+
+// Kills every process in the cgroup (cgroup.kill, or one by one on kernels
+// without it) and waits up to timeout_ms for it to empty
+bool kill_cgroup(const std::string &path, long timeout_ms = 1000);
+
+// Bytes in a huge page of the given size ("2MB", "1GB", as in the hugetlb
+// controller's file names). Returns -1 for anything else.
+long long hugepage_bytes(const std::string &size);
+
+// Checks the limits for obviously invalid values before anything is written
+bool validate_limits(const Limits &limits);
+
+// Writes every set field of limits to the cgroup. If any write fails, the
+// files already written are restored to their previous values so the cgroup
+// is left either fully updated or untouched.
+bool apply_limits(const std::string &path, const Limits &limits);
+
+// Reads the value for key from a flat-keyed cgroup file such as cpu.stat or
+// memory.events ("key value" per line). Returns -1 if missing.
+long long read_cgroup_stat(const std::string &file, const std::string &key);
+
+// Reads a single-value cgroup file such as memory.current. Returns -1 if missing.
+long long read_cgroup_value(const std::string &file);
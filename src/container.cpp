@@ -0,0 +1,685 @@
+#include "container.hpp"
+#include "net.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef PR_SCHED_CORE
+#define PR_SCHED_CORE 62
+#define PR_SCHED_CORE_GET 0
+#define PR_SCHED_CORE_CREATE 1
+#define PR_SCHED_CORE_SHARE_FROM 3
+#define PR_SCHED_CORE_SCOPE_THREAD 0
+#define PR_SCHED_CORE_SCOPE_THREAD_GROUP 1
+#endif
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#define SCHED_FLAG_RESET_ON_FORK 0x01
+#endif
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE 67
+#endif
+#ifndef PR_THP_DISABLE_EXCEPT_ADVISED
+#define PR_THP_DISABLE_EXCEPT_ADVISED (1 << 1)
+#endif
+
+// struct sched_attr as the kernel takes it (<linux/sched/types.h> clashes
+// with <sched.h>, and glibc has no sched_setattr() wrapper before 2.41)
+struct SchedAttr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+// Phases the child reports back to the supervisor over the status pipe
+enum ChildPhase : uint32_t {
+    CHILD_SYNC_WAIT,   // Blocked until the supervisor finished the cgroup setup
+    CHILD_NAMESPACES,  // Namespaces entered after the clone (cgroup, time) and set up
+    CHILD_SCHED,       // Scheduling policy, nice level and core scheduling cookie set
+    CHILD_MOUNT,       // Volumes mounted into the rootfs
+    CHILD_CHROOT,
+    CHILD_EXEC,        // Ends when the exec closes the pipe (observed by the supervisor)
+    CHILD_ERROR,       // start_ns holds the errno of the failed step
+};
+
+static const char *const child_phase_names[] = {"sync wait", "namespaces", "sched", "mount", "chroot", "exec"};
+
+// Fixed-size record written by the child, well below PIPE_BUF so it is atomic
+struct ChildReport {
+    uint32_t phase;
+    uint32_t reserved;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+// Arguments handed to the child through clone()
+struct ChildArgs {
+    const ContainerConfig *config;
+    int sync_pipe[2];
+    int status_pipe[2];
+    char **envp;  // Environment for the command, prepared by the parent
+    const char *shm_target;  // <rootfs>/dev/shm, or null without a shm volume
+    const char *hugetlbfs_target;   // <rootfs><hugetlbfs_path>, or null without one
+    const char *hugetlbfs_options;  // Mount options with its page size and size
+};
+
+// Reports a failed step on stderr without stdio. Unlike fork(), clone()
+// does not reset locks that other supervisor threads (benchmarks, batch
+// runs) may hold, so the child must not take the stdio or malloc locks.
+static void child_error(const char *what) {
+    const char *reason = strerror(errno);
+    const char *parts[] = {"Error in ", what, ": ", reason, "\n"};
+    for (const char *part : parts) {
+        write(STDERR_FILENO, part, strlen(part));
+    }
+}
+
+static void report(int fd, ChildPhase phase, uint64_t start_ns, uint64_t end_ns) {
+    ChildReport record{phase, 0, start_ns, end_ns};
+    write(fd, &record, sizeof(record));
+}
+
+// Minimal init: starts the command as its child, reaps whatever else ends
+// up orphaned in the namespace, forwards every signal it gets to the
+// command and exits with the command's exit code, or 128 + the signal that
+// killed it. The processes left behind are killed by the kernel when it exits.
+[[noreturn]] static void run_init(char *const cmd[], int status_fd) {
+    // Signals are only taken with sigwaitinfo(); as PID 1 we would not get
+    // default actions for them anyway
+    sigset_t all, original;
+    sigfillset(&all);
+    sigprocmask(SIG_BLOCK, &all, &original);
+
+    // A raw clone rather than fork(), which runs atfork handlers and takes
+    // locks other supervisor threads may have held when we were cloned
+    pid_t command = syscall(SYS_clone, SIGCHLD, 0, 0, 0, 0);
+    if (command == -1) {
+        int error = errno;
+        child_error("fork");
+        report(status_fd, CHILD_ERROR, error, 0);
+        _exit(1);
+    }
+    if (command == 0) {
+        sigprocmask(SIG_SETMASK, &original, nullptr);
+        report(status_fd, CHILD_EXEC, monotonic_ns(), 0);
+        execvp(cmd[0], cmd);
+        int error = errno;
+        child_error("execvp");
+        report(status_fd, CHILD_ERROR, error, 0);
+        _exit(127);
+    }
+    // Nothing here execs, so close-on-exec never closes what we inherited
+    // from the supervisor: the status pipe (the supervisor sees EOF once
+    // the command's exec closes the last copy), but also the other ends of
+    // the command's stdio pipes, which would otherwise never see EOF
+    if (syscall(SYS_close_range, 3, ~0U, 0) == -1) {
+        for (int fd = 3; fd < 1024; fd++) {
+            close(fd);
+        }
+    }
+
+    for (;;) {
+        siginfo_t info;
+        int sig = sigwaitinfo(&all, &info);
+        if (sig == -1) {
+            continue;
+        }
+        if (sig != SIGCHLD) {
+            kill(command, sig);
+            continue;
+        }
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            if (pid == command) {
+                _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+            }
+        }
+    }
+}
+
+// Child process function: Runs in the new namespace, executes command
+static int child_process(void *arg) {
+    ChildArgs *args = static_cast<ChildArgs *>(arg);
+    const ContainerConfig &config = *args->config;
+    int status_fd = args->status_pipe[1];
+    close(args->status_pipe[0]);
+
+    // Die with the thread that cloned us, so a killed supervisor does not
+    // leave the container running in a cgroup nobody will clean up. If it
+    // is already gone, the sync pipe below reads EOF and we exit anyway.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    // Wait until the parent has finished setting up our cgroup. A closed pipe
+    // without the go byte means the parent gave up on us.
+    uint64_t start = monotonic_ns();
+    close(args->sync_pipe[1]);
+    char go = 0;
+    if (read(args->sync_pipe[0], &go, 1) != 1) {
+        _exit(1);
+    }
+    close(args->sync_pipe[0]);
+    report(status_fd, CHILD_SYNC_WAIT, start, monotonic_ns());
+
+    // Redirect stdio, e.g. into the supervisor's log pipes. dup2() clears
+    // close-on-exec on the copies, so only these survive the exec.
+    const int redirects[][2] = {{config.stdin_fd, STDIN_FILENO}, {config.stdout_fd, STDOUT_FILENO},
+                                {config.stderr_fd, STDERR_FILENO}};
+    for (const auto &redirect : redirects) {
+        if (redirect[0] != -1 && dup2(redirect[0], redirect[1]) == -1) {
+            int error = errno;
+            child_error("dup2");
+            report(status_fd, CHILD_ERROR, error, 0);
+            _exit(1);
+        }
+    }
+
+    // A cgroup namespace is rooted at the cgroup of the process creating it,
+    // so it is only entered now that the parent has moved us into ours. A
+    // time namespace applies to the children of its creator, which includes
+    // the exec below. Neither can be requested through clone() itself.
+    start = monotonic_ns();
+    for (const auto &join : config.join_namespaces) {
+        if (setns(join.second, join.first) == -1) {
+            int error = errno;
+            child_error("setns");
+            report(status_fd, CHILD_ERROR, error, 0);
+            _exit(1);
+        }
+    }
+    if (((config.namespaces & CLONE_NEWCGROUP) && unshare(CLONE_NEWCGROUP) == -1) ||
+        ((config.namespaces & CLONE_NEWTIME) && unshare(CLONE_NEWTIME) == -1) ||
+        ((config.namespaces & CLONE_NEWNET) && !bring_up_loopback())) {
+        int error = errno;
+        child_error("namespace setup");
+        report(status_fd, CHILD_ERROR, error, 0);
+        _exit(1);
+    }
+    report(status_fd, CHILD_NAMESPACES, start, monotonic_ns());
+
+    // One sched_setattr() sets the policy, nice level and slice together.
+    // For the fair classes sched_runtime is the slice EEVDF gives each run
+    // (kernels before 6.12 ignore it): short slices get picked sooner,
+    // long ones are preempted less. Core scheduling only lets tasks with
+    // the same cookie share a core's SMT siblings.
+    if (!config.sched.is_default()) {
+        start = monotonic_ns();
+        SchedAttr attr{};
+        attr.size = sizeof(attr);
+        attr.sched_policy = config.sched.policy;
+        attr.sched_nice = config.sched.nice;
+        attr.sched_runtime = config.sched.slice_us * 1000;
+        const char *failed = nullptr;
+        if (syscall(SYS_sched_setattr, 0, &attr, 0) == -1) {
+            failed = "sched_setattr";
+        } else if (config.sched.core_cookie &&
+                   prctl(PR_SCHED_CORE, PR_SCHED_CORE_CREATE, 0, PR_SCHED_CORE_SCOPE_THREAD_GROUP, 0) == -1) {
+            failed = "PR_SCHED_CORE_CREATE";
+        }
+        if (failed) {
+            int error = errno;
+            child_error(failed);
+            report(status_fd, CHILD_ERROR, error, 0);
+            _exit(1);
+        }
+        report(status_fd, CHILD_SCHED, start, monotonic_ns());
+    }
+
+    // Kept across fork and exec. Without PR_THP_DISABLE_EXCEPT_ADVISED
+    // (6.18+) "madvise" fails rather than silently meaning "never".
+    if (config.thp != THP_INHERIT &&
+        prctl(PR_SET_THP_DISABLE, 1, config.thp == THP_MADVISE ? PR_THP_DISABLE_EXCEPT_ADVISED : 0, 0, 0) == -1) {
+        int error = errno;
+        child_error("PR_SET_THP_DISABLE");
+        report(status_fd, CHILD_ERROR, error, 0);
+        _exit(1);
+    }
+
+    // Marks the whole address space mergeable, without the program having
+    // to madvise(MADV_MERGEABLE) it; kept across fork and exec
+    if (config.ksm && prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0) == -1) {
+        int error = errno;
+        child_error("PR_SET_MEMORY_MERGE");
+        report(status_fd, CHILD_ERROR, error, 0);
+        _exit(1);
+    }
+
+    // Mount volumes while the host paths are still reachable. Our mounts
+    // are made private first, so nothing mounted here propagates back to
+    // the host's namespace.
+    if (args->shm_target || args->hugetlbfs_target) {
+        start = monotonic_ns();
+        const char *failed = nullptr;
+        if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) == -1) {
+            failed = "mount --make-rprivate /";
+        } else if (args->shm_target && mount(config.shm_path.c_str(), args->shm_target, NULL, MS_BIND, NULL) == -1) {
+            failed = "mount /dev/shm";
+        } else if (args->hugetlbfs_target &&
+                   ((mkdir(args->hugetlbfs_target, 0755) == -1 && errno != EEXIST) ||
+                    mount("hugetlbfs", args->hugetlbfs_target, "hugetlbfs", MS_NOSUID | MS_NODEV, args->hugetlbfs_options) == -1)) {
+            failed = "mount hugetlbfs";
+        }
+        if (failed) {
+            int error = errno;
+            child_error(failed);
+            report(status_fd, CHILD_ERROR, error, 0);
+            _exit(1);
+        }
+        report(status_fd, CHILD_MOUNT, start, monotonic_ns());
+    }
+
+    // [TODO] Automatically install image if not present
+    // Change the root directory of the container
+    start = monotonic_ns();
+    if (chroot(config.rootfs.c_str()) == -1) {
+        int error = errno;
+        child_error("chroot");
+        report(status_fd, CHILD_ERROR, error, 0);
+        _exit(1);
+    }
+
+    // Change the working directory to "/"
+    chdir("/");
+    report(status_fd, CHILD_CHROOT, start, monotonic_ns());
+    // Set PATH Variables for the container. The environment is swapped
+    // wholesale, since setenv() allocates.
+    environ = args->envp;
+
+    // Built-in workloads run in place; closing the pipe stands in for the
+    // exec. So does closing everything above stderr: containers cloned
+    // concurrently by the benchmarks inherit each other's sync and status
+    // pipe ends, and holding one open would stall that container's start.
+    if (config.workload) {
+        report(status_fd, CHILD_EXEC, monotonic_ns(), 0);
+        if (syscall(SYS_close_range, 3, ~0U, 0) == -1) {
+            for (int fd = 3; fd < 1024; fd++) {
+                close(fd);
+            }
+        }
+        _exit(config.workload());
+    }
+
+    // Ignored signals stay ignored across exec, and dockher pipe ignores
+    // SIGPIPE for its pumps. The command (and, through the init, anything
+    // it starts) must die on a closed pipe as it would in a shell.
+    signal(SIGPIPE, SIG_DFL);
+
+    // Execute the command passed by the user. The status pipe is close-on-exec,
+    // so the supervisor sees EOF exactly when the exec succeeds.
+    char *const cmd[] = {(char*)"sh", (char*)"-c", (char*)config.cmd.c_str(), NULL}; // Run the command in a shell
+    if (config.init && (config.namespaces & CLONE_NEWPID)) {
+        run_init(cmd, status_fd);
+    }
+    report(status_fd, CHILD_EXEC, monotonic_ns(), 0);
+    execvp(cmd[0], cmd);
+
+    // If execvp fails
+    int error = errno;
+    child_error("execvp");
+    report(status_fd, CHILD_ERROR, error, 0);
+    return 1;
+}
+
+// Namespace names accepted by --ns, as in /proc/<pid>/ns
+static const std::pair<const char *, int> namespace_names[] = {
+    {"pid", CLONE_NEWPID}, {"mnt", CLONE_NEWNS}, {"net", CLONE_NEWNET}, {"ipc", CLONE_NEWIPC},
+    {"uts", CLONE_NEWUTS}, {"user", CLONE_NEWUSER}, {"cgroup", CLONE_NEWCGROUP}, {"time", CLONE_NEWTIME},
+};
+
+bool parse_namespaces(const std::string &list, int &flags) {
+    flags = 0;
+    if (list == "none") {
+        return true;
+    }
+    std::stringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        bool found = false;
+        for (const auto &known : namespace_names) {
+            if (name == known.first) {
+                flags |= known.second;
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown namespace \"" << name << "\" (available: pid, mnt, net, ipc, uts, user, cgroup, time, none)"
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_sched_policy(const std::string &name, int &policy) {
+    if (name == "other") {
+        policy = SCHED_OTHER;
+    } else if (name == "batch") {
+        policy = SCHED_BATCH;
+    } else if (name == "idle") {
+        policy = SCHED_IDLE;
+    } else {
+        std::cerr << "Unknown scheduling policy \"" << name << "\" (available: other, batch, idle)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parse_thp_policy(const std::string &name, ThpPolicy &thp) {
+    if (name == "inherit") {
+        thp = THP_INHERIT;
+    } else if (name == "madvise") {
+        thp = THP_MADVISE;
+    } else if (name == "never") {
+        thp = THP_NEVER;
+    } else {
+        std::cerr << "Unknown THP policy \"" << name << "\" (available: inherit, madvise, never)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool validate_sched(const SchedConfig &sched) {
+    if (sched.nice < -20 || sched.nice > 19) {
+        std::cerr << "Nice level must be between -20 and 19" << std::endl;
+        return false;
+    }
+    // The kernel clamps custom slices to 0.1-100ms
+    if (sched.slice_us != 0 && (sched.slice_us < 100 || sched.slice_us > 100000)) {
+        std::cerr << "Slice must be between 100 and 100000 (us)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool inherit_sched(pid_t pid) {
+    SchedAttr attr{};
+    if (syscall(SYS_sched_getattr, pid, &attr, sizeof(attr), 0) == -1) {
+        std::cerr << "Failed to read the scheduling attributes of " << pid << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Only reset-on-fork is meaningful at this size of sched_attr
+    attr.sched_flags &= SCHED_FLAG_RESET_ON_FORK;
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) == -1) {
+        std::cerr << "Error in sched_setattr: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Kernels without core scheduling, or without SMT, fail the query;
+    // then there is no cookie to share. Only a single thread can pull
+    // another's cookie, which our children inherit on fork.
+    unsigned long cookie = 0;
+    if (prctl(PR_SCHED_CORE, PR_SCHED_CORE_GET, pid, PR_SCHED_CORE_SCOPE_THREAD, &cookie) == 0 && cookie != 0 &&
+        prctl(PR_SCHED_CORE, PR_SCHED_CORE_SHARE_FROM, pid, PR_SCHED_CORE_SCOPE_THREAD, 0) == -1) {
+        std::cerr << "Error in PR_SCHED_CORE_SHARE_FROM: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool set_memory_policy(ThpPolicy thp, bool ksm) {
+    if (thp != THP_INHERIT &&
+        prctl(PR_SET_THP_DISABLE, 1, thp == THP_MADVISE ? PR_THP_DISABLE_EXCEPT_ADVISED : 0, 0, 0) == -1) {
+        std::cerr << "Error in PR_SET_THP_DISABLE: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (ksm && prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0) == -1) {
+        std::cerr << "Error in PR_SET_MEMORY_MERGE: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool parse_container_spec(const std::string &spec, ContainerConfig &config) {
+    // Only treat the part before the first ':' as limits if it looks like
+    // key=value pairs, so commands containing ':' need no escaping
+    size_t colon = spec.find(':');
+    std::string prefix = colon == std::string::npos ? "" : spec.substr(0, colon);
+    if (prefix.empty() || prefix.find('=') == std::string::npos || prefix.find(' ') != std::string::npos) {
+        config.cmd = spec;
+        return !config.cmd.empty();
+    }
+    config.cmd = spec.substr(colon + 1);
+
+    std::stringstream pairs(prefix);
+    std::string pair;
+    while (std::getline(pairs, pair, ',')) {
+        size_t eq = pair.find('=');
+        std::string key = pair.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : pair.substr(eq + 1);
+        try {
+            if (key == "mem") {
+                config.limits.mem_mb = std::stoll(value);
+            } else if (key == "cpu") {
+                config.limits.cpu_pct = std::stoi(value);
+            } else if (key == "cpu-period") {
+                config.limits.cpu_period_us = std::stoi(value);
+            } else if (key == "cpuset-cpus") {
+                config.limits.cpuset_cpus = value;
+            } else if (key == "cpuset-mems") {
+                config.limits.cpuset_mems = value;
+            } else {
+                std::cerr << "Unknown key \"" << key << "\" in: " << spec << std::endl;
+                return false;
+            }
+        } catch (const std::exception &) {
+            std::cerr << "Invalid value for " << key << " in: " << spec << std::endl;
+            return false;
+        }
+    }
+    if (config.cmd.empty()) {
+        std::cerr << "Missing command in: " << spec << std::endl;
+        return false;
+    }
+    return validate_limits(config.limits);
+}
+
+bool create_container(const ContainerConfig &config, Container &container) {
+    container.config = &config;
+    container.created_ns = monotonic_ns();
+    pid_t self = getpid();
+
+    // Without its own mount namespace, the container's mounts would land
+    // in the host's
+    if ((!config.shm_path.empty() || !config.hugetlbfs_path.empty()) && !(config.namespaces & CLONE_NEWNS)) {
+        std::cerr << "Mounting volumes needs a mount namespace (--ns mnt)" << std::endl;
+        return false;
+    }
+
+    // Allocate memory for the child stack
+    container.stack = (char *)malloc(STACK_SIZE);
+    if (!container.stack) {
+        std::cerr << "Failed to allocate stack for child process" << std::endl;
+        return false;
+    }
+
+    // Our environment with the container's PATH, built here because the
+    // child cannot allocate
+    std::vector<std::string> env;
+    for (char **var = environ; *var; var++) {
+        if (strncmp(*var, "PATH=", 5) != 0) {
+            env.push_back(*var);
+        }
+    }
+    env.push_back(CONTAINER_PATH);
+    std::vector<char *> envp;
+    for (std::string &var : env) {
+        envp.push_back(&var[0]);
+    }
+    envp.push_back(nullptr);
+
+    std::string shm_target = config.rootfs + "/dev/shm";
+    std::string hugetlbfs_target = config.rootfs + config.hugetlbfs_path;
+    // hugetlbfs takes sizes as 2M rather than the controller's 2MB
+    std::string hugetlbfs_options = "pagesize=" + config.limits.hugetlb_size.substr(0, config.limits.hugetlb_size.size() - 1);
+    if (config.limits.hugetlb_pages != -1) {
+        hugetlbfs_options += ",size=" + std::to_string(config.limits.hugetlb_pages * hugepage_bytes(config.limits.hugetlb_size));
+    }
+    ChildArgs args{&config, {-1, -1}, {-1, -1}, envp.data(), config.shm_path.empty() ? nullptr : shm_target.c_str(),
+                   config.hugetlbfs_path.empty() ? nullptr : hugetlbfs_target.c_str(), hugetlbfs_options.c_str()};
+    if (pipe2(args.sync_pipe, O_CLOEXEC) == -1 || pipe2(args.status_pipe, O_CLOEXEC) == -1) {
+        std::cerr << "Error in pipe: " << strerror(errno) << std::endl;
+        for (int fd : {args.sync_pipe[0], args.sync_pipe[1]}) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+        destroy_container(container);
+        return false;
+    }
+    uint64_t start = monotonic_ns();
+    container.spans.push_back({"stack allocation", container.created_ns, start, self});
+
+    // The child process will run in the requested namespaces, except the
+    // ones it enters itself. Without CLONE_VM it gets its own copy of args
+    // along with the rest of our memory.
+    int clone_flags = config.namespaces & ~(CLONE_NEWCGROUP | CLONE_NEWTIME);
+    container.pid = clone(child_process, container.stack + STACK_SIZE, clone_flags | SIGCHLD, &args);
+    close(args.sync_pipe[0]);
+    close(args.status_pipe[1]);
+    container.sync_fd = args.sync_pipe[1];
+    container.status_fd = args.status_pipe[0];
+    if (container.pid == -1) {
+        std::cerr << "Error in clone: " << strerror(errno) << std::endl;
+        destroy_container(container);
+        return false;
+    }
+    // Supervisors wait for the exit on it in their event loops (Linux 5.3+)
+    container.pidfd = syscall(SYS_pidfd_open, container.pid, 0);
+    if (container.pidfd == -1) {
+        std::cerr << "Error in pidfd_open: " << strerror(errno) << std::endl;
+        destroy_container(container);
+        return false;
+    }
+
+    // Map root in a new user namespace to whoever runs dockher, so the
+    // container keeps root inside it (for chroot and mounts) without any
+    // other host ids. Unprivileged writers must give up setgroups() first.
+    if (config.namespaces & CLONE_NEWUSER) {
+        std::string proc = "/proc/" + std::to_string(container.pid);
+        if ((geteuid() != 0 && !write_to_file(proc + "/setgroups", "deny")) ||
+            !write_to_file(proc + "/uid_map", "0 " + std::to_string(geteuid()) + " 1") ||
+            !write_to_file(proc + "/gid_map", "0 " + std::to_string(getegid()) + " 1")) {
+            destroy_container(container);
+            return false;
+        }
+    }
+    container.spans.push_back({"clone", start, monotonic_ns(), self});
+
+    // Unified cgroup v2 directory
+    start = monotonic_ns();
+    std::string pid_str = std::to_string(container.pid);
+    std::string cgroup_path = config.cgroup_parent + "/dockher_" + pid_str;
+    enable_controllers(config.cgroup_parent);
+    if (!create_cgroup(cgroup_path)) {
+        destroy_container(container);
+        return false;
+    }
+    container.cgroup = cgroup_path;
+    container.spans.push_back({"cgroup mkdir", start, monotonic_ns(), self});
+
+    // Write the limits, then add the child process to the cgroup
+    start = monotonic_ns();
+    if (!apply_limits(cgroup_path, config.limits) || !write_to_file(cgroup_path + "/cgroup.procs", pid_str)) {
+        destroy_container(container);
+        return false;
+    }
+    container.spans.push_back({"cgroup config", start, monotonic_ns(), self});
+    return true;
+}
+
+bool start_container(Container &container) {
+    char go = 1;
+    bool ok = write(container.sync_fd, &go, 1) == 1;
+    close(container.sync_fd);
+    container.sync_fd = -1;
+    if (!ok) {
+        std::cerr << "Failed to start container " << container.pid << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Collect the child's phase reports until the exec closes the pipe
+    ChildReport record;
+    uint64_t exec_start = 0;
+    ssize_t n;
+    while ((n = read(container.status_fd, &record, sizeof(record))) != 0) {
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n != sizeof(record)) {
+            ok = false;
+            break;
+        }
+        if (record.phase == CHILD_ERROR) {
+            ok = false;
+        } else if (record.phase == CHILD_EXEC) {
+            exec_start = record.start_ns;
+        } else if (record.phase < CHILD_ERROR) {
+            container.spans.push_back({child_phase_names[record.phase], record.start_ns, record.end_ns, container.pid});
+        }
+    }
+    close(container.status_fd);
+    container.status_fd = -1;
+
+    // EOF without an exec report means the child died before getting there
+    if (!ok || exec_start == 0) {
+        std::cerr << "Container " << container.pid << " failed to start" << std::endl;
+        return false;
+    }
+    container.exec_ns = monotonic_ns();
+    container.spans.push_back({child_phase_names[CHILD_EXEC], exec_start, container.exec_ns, container.pid});
+    return true;
+}
+
+int wait_container(Container &container) {
+    int status = 0;
+    while (waitpid(container.pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    container.reaped = true;
+    container.exited_ns = monotonic_ns();
+    if (container.exec_ns) {
+        container.spans.push_back({"wait", container.exec_ns, container.exited_ns, getpid()});
+    }
+    return status;
+}
+
+void destroy_container(Container &container) {
+    uint64_t start = monotonic_ns();
+    for (int *fd : {&container.sync_fd, &container.status_fd, &container.pidfd}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    if (container.pid != -1 && !container.reaped) {
+        kill(container.pid, SIGKILL);
+        wait_container(container);
+    }
+    if (!container.cgroup.empty()) {
+        remove_cgroup(container.cgroup);
+        container.cgroup.clear();
+    }
+
+    // Free the allocated stack
+    free(container.stack);
+    container.stack = nullptr;
+    container.spans.push_back({"teardown", start, monotonic_ns(), getpid()});
+}
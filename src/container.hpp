@@ -0,0 +1,150 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include <sys/types.h>
+#include "cgroup.hpp"
+#include "trace.hpp"
+
+// Size of stack for the child process
+#define STACK_SIZE 1024 * 1024 // 1 MB stack
+
+// Default root filesystem of a container
+#define DEFAULT_ROOTFS "./images/ubuntu"
+
+// PATH inside the container
+#define CONTAINER_PATH "PATH=/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin:/usr/games"
+
+// Namespaces a container gets unless told otherwise
+#define DEFAULT_NAMESPACES (CLONE_NEWPID | CLONE_NEWNS)
+
+// How the container's processes are scheduled. Applied by the child before
+// exec, and inherited by everything the command starts.
+struct SchedConfig {
+    int policy = SCHED_OTHER;  // SCHED_OTHER, SCHED_BATCH or SCHED_IDLE
+    int nice = 0;              // -20 (most CPU) to 19 (least)
+    long slice_us = 0;         // EEVDF time slice requested per run; 0 = kernel default
+    bool core_cookie = false;  // Own core scheduling cookie, so no other container shares its SMT siblings
+
+    bool is_default() const { return policy == SCHED_OTHER && nice == 0 && slice_us == 0 && !core_cookie; }
+};
+
+// Transparent huge page policy of the container's processes. It can only
+// be narrowed from the host's: "madvise" limits THP to regions the program
+// asks for with madvise(MADV_HUGEPAGE), "never" turns it off.
+enum ThpPolicy { THP_INHERIT, THP_MADVISE, THP_NEVER };
+
+// Everything needed to launch a container
+struct ContainerConfig {
+    std::string cmd;                      // Command run with "sh -c"
+    std::string rootfs = DEFAULT_ROOTFS;  // Path to the root filesystem
+    Limits limits;
+    SchedConfig sched;
+    ThpPolicy thp = THP_INHERIT;
+
+    // Runs a minimal init as PID 1 of the container's PID namespace, which
+    // starts the command, reaps orphaned processes and forwards signals to
+    // the command. Without it the command is PID 1 itself.
+    bool init = true;
+
+    // Opts all of the container's anonymous memory into kernel samepage
+    // merging, so identical pages across containers are stored once
+    bool ksm = false;
+
+    // CLONE_NEW* flags of the namespaces to create; the rest are shared
+    // with the host (see parse_namespaces())
+    int namespaces = DEFAULT_NAMESPACES;
+
+    // Existing namespaces the child joins with setns() before exec, as
+    // (CLONE_NEW* type, descriptor) pairs, e.g. a pooled network namespace
+    // or a pod's. Leave their types out of namespaces.
+    std::vector<std::pair<int, int>> join_namespaces;
+
+    // Cgroup the container's cgroup is created in
+    std::string cgroup_parent = CGROUP_ROOT;
+
+    // Host directory bind-mounted onto /dev/shm in the container; empty
+    // keeps the rootfs's own /dev/shm (see ShmVolume)
+    std::string shm_path;
+
+    // Path in the container to mount a hugetlbfs on, with pages of
+    // limits.hugetlb_size; empty mounts none
+    std::string hugetlbfs_path;
+
+    // Descriptors the child gets as stdin/stdout/stderr; -1 inherits ours
+    int stdin_fd = -1;
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+
+    // Built-in workload run in the container instead of exec'ing cmd. Used
+    // by the benchmarks, so calibrated workloads do not depend on the
+    // binaries in the rootfs; the child still chroots into it first, so the
+    // rootfs must exist. Its return value is the container's exit code.
+    std::function<int()> workload;
+};
+
+// A launched container, owned by the dockher process that created it
+struct Container {
+    const ContainerConfig *config = nullptr;
+    pid_t pid = -1;          // Host pid of the container's init process (also its id)
+    int pidfd = -1;          // pidfd of the init process, readable once it exits
+    std::string cgroup;      // Full path of the container's cgroup
+    char *stack = nullptr;   // Stack passed to clone()
+    int sync_fd = -1;        // Write end of the pipe the child waits on before exec
+    int status_fd = -1;      // Read end of the pipe the child reports its phases on
+    bool reaped = false;     // Set once wait_container() has collected the exit status
+
+    // Timed lifecycle phases, from both the supervisor and the child
+    std::vector<TraceSpan> spans;
+    uint64_t created_ns = 0;  // When create_container() was called
+    uint64_t exec_ns = 0;     // When the child's exec succeeded
+    uint64_t exited_ns = 0;   // When wait_container() reaped the child
+};
+
+// Parses a comma-separated list of namespace names (pid, mnt, net, ipc,
+// uts, user, cgroup, time, or "none") into CLONE_NEW* flags
+bool parse_namespaces(const std::string &list, int &flags);
+
+// Parses a scheduling policy name (other, batch or idle) into SCHED_*
+bool parse_sched_policy(const std::string &name, int &policy);
+
+// Parses a THP policy name (inherit, madvise or never)
+bool parse_thp_policy(const std::string &name, ThpPolicy &thp);
+
+// Checks the nice level and slice for out-of-range values
+bool validate_sched(const SchedConfig &sched);
+
+// Gives the calling process the scheduling policy, nice level, slice and
+// core scheduling cookie of process pid, e.g. a container's init, so that
+// commands started later are scheduled like the container's own
+bool inherit_sched(pid_t pid);
+
+// Applies a container's THP policy and KSM opt-in to the calling process;
+// both are kept across fork and exec
+bool set_memory_policy(ThpPolicy thp, bool ksm);
+
+// Parses a "[key=value,...:]command" spec for commands that launch several
+// containers at once, e.g. "mem=200,cpu=50:grep foo". Known keys are mem,
+// cpu, cpu-period, cpuset-cpus and cpuset-mems. Returns false on a bad spec.
+bool parse_container_spec(const std::string &spec, ContainerConfig &config);
+
+// Clones the container and places it in its cgroup with its limits applied.
+// The child waits before chroot/exec until start_container() is called, so
+// anything attached to the cgroup in between sees the workload from its
+// first instruction. On failure everything created so far is torn down.
+bool create_container(const ContainerConfig &config, Container &container);
+
+// Lets the container's child continue to exec its command, and waits until
+// the exec has happened. Returns false if the child failed before or in exec.
+bool start_container(Container &container);
+
+// Waits for the container's init process to exit. Returns its exit status
+// as reported by waitpid, or -1 on error.
+int wait_container(Container &container);
+
+// Kills a container that has not been waited for, then releases its cgroup,
+// stack and descriptors. Recorded as the "teardown" span.
+void destroy_container(Container &container);
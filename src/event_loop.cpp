@@ -0,0 +1,102 @@
+#include "event_loop.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+EventLoop::EventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        std::cerr << "Error in epoll_create1: " << strerror(errno) << std::endl;
+    }
+}
+
+EventLoop::~EventLoop() {
+    for (const auto &timer : timers_) {
+        close(timer);
+    }
+    if (epoll_fd_ != -1) {
+        close(epoll_fd_);
+    }
+}
+
+bool EventLoop::add(int fd, std::function<void()> handler, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+        std::cerr << "Error in epoll_ctl: " << strerror(errno) << std::endl;
+        return false;
+    }
+    handlers_[fd] = std::move(handler);
+    return true;
+}
+
+void EventLoop::remove(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    handlers_.erase(fd);
+    if (timers_.erase(fd)) {
+        close(fd);
+    }
+}
+
+int EventLoop::add_timer(long interval_ms, std::function<void()> handler, bool periodic) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd == -1) {
+        std::cerr << "Error in timerfd_create: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    itimerspec spec{};
+    spec.it_value.tv_sec = interval_ms / 1000;
+    spec.it_value.tv_nsec = (interval_ms % 1000) * 1000000;
+    if (periodic) {
+        spec.it_interval = spec.it_value;
+    }
+    timerfd_settime(fd, 0, &spec, nullptr);
+
+    timers_.insert(fd);
+    bool added = add(fd, [this, fd, periodic, handler]() {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            return;
+        }
+        if (!periodic) {
+            remove(fd);
+        }
+        handler();
+    });
+    if (!added) {
+        timers_.erase(fd);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool EventLoop::run() {
+    running_ = true;
+    epoll_event events[16];
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, 16, -1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error in epoll_wait: " << strerror(errno) << std::endl;
+            return false;
+        }
+        for (int i = 0; i < n && running_; i++) {
+            auto it = handlers_.find(events[i].data.fd);
+            if (it == handlers_.end()) {
+                continue;  // Removed by an earlier handler in this batch
+            }
+            // Copied, since the handler may remove itself
+            std::function<void()> handler = it->second;
+            handler();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <set>
+#include <sys/epoll.h>
+
+// Minimal epoll loop the supervisor uses to wait on the container's pidfd,
+// timers and pipes at the same time instead of blocking in waitpid
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // Calls handler whenever fd becomes ready for events
+    bool add(int fd, std::function<void()> handler, uint32_t events = EPOLLIN);
+
+    // Stops watching fd. Safe to call from inside a handler.
+    void remove(int fd);
+
+    // Creates a timerfd firing every interval_ms and calls handler on each
+    // expiry (or once, if periodic is false). Returns the timerfd, owned by the loop.
+    int add_timer(long interval_ms, std::function<void()> handler, bool periodic = true);
+
+    // Makes run() return after the current handler
+    void stop() { running_ = false; }
+
+    // Dispatches events until stop() is called. Returns false on an epoll error.
+    bool run();
+
+private:
+    int epoll_fd_;
+    bool running_ = false;
+    std::map<int, std::function<void()>> handlers_;
+    std::set<int> timers_;  // Timer fds owned by the loop
+};
@@ -0,0 +1,176 @@
+#include "exec.hpp"
+#include "cgroup.hpp"
+#include "container.hpp"
+#include "state.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+// Namespace types a container may have, as named in /proc/<pid>/ns
+static const std::pair<int, const char *> exec_namespaces[] = {
+    {CLONE_NEWUSER, "user"}, {CLONE_NEWNS, "mnt"}, {CLONE_NEWPID, "pid"}, {CLONE_NEWNET, "net"},
+    {CLONE_NEWIPC, "ipc"}, {CLONE_NEWUTS, "uts"}, {CLONE_NEWCGROUP, "cgroup"}, {CLONE_NEWTIME, "time"},
+};
+
+// The namespaces the container does not share with us. setns() refuses to
+// re-enter some namespaces we are already in (e.g. our own user namespace).
+static int container_namespaces(pid_t pid) {
+    int flags = 0;
+    for (const auto &ns : exec_namespaces) {
+        struct stat ours, theirs;
+        std::string path = "/proc/" + std::to_string(pid) + "/ns/" + ns.second;
+        std::string self = std::string("/proc/self/ns/") + ns.second;
+        if (stat(path.c_str(), &theirs) == 0 && stat(self.c_str(), &ours) == 0 && theirs.st_ino != ours.st_ino) {
+            flags |= ns.first;
+        }
+    }
+    return flags;
+}
+
+int exec_main(int argc, char *argv[]) {
+    // Parsed by hand: everything after the id is the command, options and
+    // commas included, which an option parser would try to interpret
+    bool help = argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0);
+    if (argc < 3 || help) {
+        std::cout << "Run a command inside a running container\n"
+                  << "Usage:\n  dockher exec <id> <command> [args...]\n"
+                  << "The command is run as given; use sh -c \"...\" for shell syntax" << std::endl;
+        return help ? 0 : 1;
+    }
+    ContainerState state;
+    if (!load_state(argv[1], state)) {
+        return 1;
+    }
+    int pidfd = syscall(SYS_pidfd_open, state.pid, 0);
+    if (pidfd == -1) {
+        std::cerr << "Container " << state.pid << " is not running — " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    // The container's root, opened while the host's /proc is still ours to use
+    std::string root_path = "/proc/" + std::to_string(state.pid) + "/root";
+    int root_fd = open(root_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd == -1) {
+        std::cerr << "Failed to open: " << root_path << " — " << strerror(errno) << std::endl;
+        close(pidfd);
+        return 1;
+    }
+    int namespaces = container_namespaces(state.pid);
+
+    // Only the command joins the cgroup, so it is charged to the container's
+    // limits while we are not, and the container's teardown does not kill
+    // us. Opened through the host's view of the hierarchy before we leave it;
+    // the write is checked against the credentials we open it with.
+    std::string procs_path = state.cgroup + "/cgroup.procs";
+    int procs_fd = open(procs_path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (procs_fd == -1) {
+        std::cerr << "Failed to open: " << procs_path << " — " << strerror(errno) << std::endl;
+        close(pidfd);
+        close(root_fd);
+        return 1;
+    }
+
+    // Scheduled, and its memory handled, like the container's processes:
+    // without the core scheduling cookie the command could share SMT
+    // siblings with other tenants. Done while our user namespace still
+    // lets us raise the priority.
+    ThpPolicy thp = THP_INHERIT;
+    if (!parse_thp_policy(state.thp, thp) || !inherit_sched(state.pid) || !set_memory_policy(thp, state.ksm)) {
+        close(pidfd);
+        close(root_fd);
+        close(procs_fd);
+        return 1;
+    }
+
+    // Enter every namespace at once through the pidfd. The pid namespace
+    // only applies to children, hence the fork below.
+    if (namespaces && setns(pidfd, namespaces) == -1) {
+        std::cerr << "Failed to enter the namespaces of container " << state.pid << " — " << strerror(errno) << std::endl;
+        close(pidfd);
+        close(root_fd);
+        close(procs_fd);
+        return 1;
+    }
+    close(pidfd);
+    if (fchdir(root_fd) == -1 || chroot(".") == -1 || chdir("/") == -1) {
+        std::cerr << "Failed to enter the root of container " << state.pid << " — " << strerror(errno) << std::endl;
+        close(root_fd);
+        close(procs_fd);
+        return 1;
+    }
+    close(root_fd);
+
+    // The child waits until it is in the cgroup before it execs
+    int go[2];
+    if (pipe2(go, O_CLOEXEC) == -1) {
+        std::cerr << "Error in pipe: " << strerror(errno) << std::endl;
+        close(procs_fd);
+        return 1;
+    }
+
+    // The command gets the terminal's signals; we only wait for it
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    pid_t child = fork();
+    if (child == -1) {
+        std::cerr << "Error in fork: " << strerror(errno) << std::endl;
+        close(procs_fd);
+        close(go[0]);
+        close(go[1]);
+        return 1;
+    }
+    if (child == 0) {
+        close(go[1]);
+        close(procs_fd);
+        char ready = 0;
+        if (read(go[0], &ready, 1) != 1) {
+            _exit(127);
+        }
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        putenv(const_cast<char *>(CONTAINER_PATH));
+        // Run as given, like a shell would after its own quoting: argv is
+        // null-terminated, so everything after the id is the command's argv
+        execvp(argv[2], argv + 2);
+        std::cerr << "Error in execvp: " << strerror(errno) << std::endl;
+        _exit(127);
+    }
+
+    // Our pid namespace is still the host's, so the child's pid is too
+    close(go[0]);
+    std::string child_pid = std::to_string(child);
+    bool joined = write(procs_fd, child_pid.c_str(), child_pid.size()) == static_cast<ssize_t>(child_pid.size());
+    if (!joined) {
+        std::cerr << "Failed to move the command into container " << state.pid << "'s cgroup — " << strerror(errno)
+                  << std::endl;
+    }
+    close(procs_fd);
+    char ready = 1;
+    if (!joined || write(go[1], &ready, 1) != 1) {
+        kill(child, SIGKILL);
+    }
+    close(go[1]);
+
+    int status = 0;
+    while (waitpid(child, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return 1;
+        }
+    }
+    if (!joined) {
+        return 1;
+    }
+    // Same convention as a shell: 128 + signal for a killed command
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// dockher exec <id> <command...>
+// Runs a command inside a running container: in its namespaces, cgroup and
+// root filesystem. Returns the command's exit status.
+int exec_main(int argc, char *argv[]);
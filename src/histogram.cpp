@@ -0,0 +1,132 @@
+#include "histogram.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+HdrHistogram::HdrHistogram(int64_t lowest, int64_t highest, int significant_figures)
+    : lowest_(std::max<int64_t>(lowest, 1)), highest_(highest) {
+    significant_figures = std::min(std::max(significant_figures, 1), 5);
+
+    // Enough linear sub-buckets to tell apart values that differ in the last significant digit
+    int64_t largest_single_unit = 2 * static_cast<int64_t>(std::pow(10, significant_figures));
+    int sub_bucket_count_magnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+    sub_bucket_half_count_magnitude_ = std::max(sub_bucket_count_magnitude, 1) - 1;
+    unit_magnitude_ = static_cast<int>(std::floor(std::log2(static_cast<double>(lowest_))));
+    sub_bucket_count_ = 1LL << (sub_bucket_half_count_magnitude_ + 1);
+    sub_bucket_half_count_ = sub_bucket_count_ / 2;
+    sub_bucket_mask_ = (sub_bucket_count_ - 1) << unit_magnitude_;
+
+    // Each further bucket doubles the covered range
+    int buckets = 1;
+    int64_t smallest_untrackable = sub_bucket_count_ << unit_magnitude_;
+    while (smallest_untrackable <= highest_) {
+        if (smallest_untrackable > INT64_MAX / 2) {
+            buckets++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        buckets++;
+    }
+    counts_.assign((buckets + 1) * sub_bucket_half_count_, 0);
+}
+
+int HdrHistogram::bucket_index(int64_t value) const {
+    int pow2_ceiling = 64 - __builtin_clzll(static_cast<uint64_t>(value | sub_bucket_mask_));
+    return pow2_ceiling - unit_magnitude_ - (sub_bucket_half_count_magnitude_ + 1);
+}
+
+int HdrHistogram::counts_index(int64_t value) const {
+    int bucket = bucket_index(value);
+    int64_t sub_bucket = value >> (bucket + unit_magnitude_);
+    int64_t bucket_base = static_cast<int64_t>(bucket + 1) << sub_bucket_half_count_magnitude_;
+    return static_cast<int>(bucket_base + (sub_bucket - sub_bucket_half_count_));
+}
+
+int64_t HdrHistogram::value_at_index(int index) const {
+    int bucket = (index >> sub_bucket_half_count_magnitude_) - 1;
+    int64_t sub_bucket = (index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+    if (bucket < 0) {
+        sub_bucket -= sub_bucket_half_count_;
+        bucket = 0;
+    }
+    return sub_bucket << (bucket + unit_magnitude_);
+}
+
+int64_t HdrHistogram::highest_equivalent(int64_t value) const {
+    int bucket = bucket_index(value);
+    int64_t sub_bucket = value >> (bucket + unit_magnitude_);
+    int adjusted_bucket = sub_bucket >= sub_bucket_count_ ? bucket + 1 : bucket;
+    int64_t range = 1LL << (unit_magnitude_ + adjusted_bucket);
+    int64_t lowest_equivalent = sub_bucket << (bucket + unit_magnitude_);
+    return lowest_equivalent + range - 1;
+}
+
+void HdrHistogram::record(int64_t value) {
+    value = std::min(std::max(value, lowest_), highest_);
+    int index = counts_index(value);
+    if (index < 0 || index >= static_cast<int>(counts_.size())) {
+        return;
+    }
+    counts_[index]++;
+    total_++;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+void HdrHistogram::add(const HdrHistogram &other) {
+    if (other.counts_.size() != counts_.size()) {
+        return;
+    }
+    for (size_t i = 0; i < counts_.size(); i++) {
+        counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+int64_t HdrHistogram::percentile(double percent) const {
+    if (total_ == 0) {
+        return 0;
+    }
+    percent = std::min(std::max(percent, 0.0), 100.0);
+    int64_t wanted = std::max<int64_t>(1, static_cast<int64_t>(percent / 100.0 * total_ + 0.5));
+    int64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+        seen += counts_[i];
+        if (seen >= wanted) {
+            return std::min(highest_equivalent(value_at_index(static_cast<int>(i))), max_);
+        }
+    }
+    return max_;
+}
+
+double HdrHistogram::mean() const {
+    if (total_ == 0) {
+        return 0;
+    }
+    // Each count stands for the middle of its bucket
+    double sum = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+        if (counts_[i]) {
+            int64_t low = value_at_index(static_cast<int>(i));
+            sum += counts_[i] * (low + (highest_equivalent(low) - low) / 2.0);
+        }
+    }
+    return sum / total_;
+}
+
+std::string format_ns(int64_t ns) {
+    char buffer[32];
+    if (ns < 1000) {
+        snprintf(buffer, sizeof(buffer), "%lldns", static_cast<long long>(ns));
+    } else if (ns < 1000000) {
+        snprintf(buffer, sizeof(buffer), "%.2fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buffer, sizeof(buffer), "%.2fms", ns / 1e6);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.2fs", ns / 1e9);
+    }
+    return buffer;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// High dynamic range histogram (after HdrHistogram): values are bucketed
+// log-linearly so every recorded value is kept to the requested number of
+// significant decimal digits across the whole range, with fixed memory.
+class HdrHistogram {
+public:
+    // Tracks values in [lowest, highest] to significant_figures (1-5) digits
+    HdrHistogram(int64_t lowest = 1, int64_t highest = 3600LL * 1000000000LL, int significant_figures = 3);
+
+    // Records a value, clamped into the trackable range
+    void record(int64_t value);
+
+    // Adds every value recorded in other, which must have the same layout
+    void add(const HdrHistogram &other);
+
+    // Value at or below which the given percentage (0-100) of values fall
+    int64_t percentile(double percent) const;
+
+    int64_t count() const { return total_; }
+    int64_t min() const { return total_ ? min_ : 0; }
+    int64_t max() const { return max_; }
+    double mean() const;
+
+private:
+    int bucket_index(int64_t value) const;
+    int counts_index(int64_t value) const;
+    int64_t value_at_index(int index) const;
+    int64_t highest_equivalent(int64_t value) const;
+
+    int64_t lowest_;
+    int64_t highest_;
+    int unit_magnitude_;
+    int sub_bucket_half_count_magnitude_;
+    int64_t sub_bucket_count_;
+    int64_t sub_bucket_half_count_;
+    int64_t sub_bucket_mask_;
+    std::vector<int64_t> counts_;
+    int64_t total_ = 0;
+    int64_t min_ = INT64_MAX;
+    int64_t max_ = 0;
+};
+
+// Formats a duration in nanoseconds with a readable unit, e.g. "1.23ms"
+std::string format_ns(int64_t ns);
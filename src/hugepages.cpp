@@ -0,0 +1,80 @@
+#include "hugepages.hpp"
+#include "cgroup.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// Holds the pool lock for as long as it is in scope
+class PoolLock {
+public:
+    PoolLock() {
+        mkdir(STATE_DIR, 0755);
+        fd_ = open(HUGEPAGES_LOCK, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ != -1 && flock(fd_, LOCK_EX) == -1) {
+            close(fd_);
+            fd_ = -1;
+        }
+        if (fd_ == -1) {
+            std::cerr << "Failed to lock: " << HUGEPAGES_LOCK << " — " << strerror(errno) << std::endl;
+        }
+    }
+    ~PoolLock() {
+        if (fd_ != -1) {
+            close(fd_);
+        }
+    }
+    bool locked() const { return fd_ != -1; }
+
+private:
+    int fd_ = -1;
+};
+
+bool HugepageReservation::reserve(const std::string &size, long long pages) {
+    long long bytes = hugepage_bytes(size);
+    if (bytes == -1 || pages <= 0) {
+        std::cerr << "Huge pages to reserve must be a count of pages of a size like 2MB or 1GB" << std::endl;
+        return false;
+    }
+    std::string path = "/sys/kernel/mm/hugepages/hugepages-" + std::to_string(bytes / 1024) + "kB/nr_hugepages";
+    PoolLock lock;
+    if (!lock.locked()) {
+        return false;
+    }
+    long long before = read_cgroup_value(path);
+    if (before == -1) {
+        std::cerr << "Huge page size " << size << " is not supported here (no " << path << ")" << std::endl;
+        return false;
+    }
+    if (!write_to_file(path, std::to_string(before + pages))) {
+        return false;
+    }
+
+    // The kernel allocates what it can and says nothing about the rest
+    long long after = read_cgroup_value(path);
+    if (after < before + pages) {
+        std::cerr << "Only " << (after - before) << " of " << pages << " huge pages of " << size
+                  << " could be allocated" << std::endl;
+        write_to_file(path, std::to_string(before));
+        return false;
+    }
+    nr_path_ = path;
+    added_ = pages;
+    return true;
+}
+
+void HugepageReservation::release() {
+    if (added_ == 0) {
+        return;
+    }
+    PoolLock lock;
+    long long current = read_cgroup_value(nr_path_);
+    if (current != -1) {
+        write_to_file(nr_path_, std::to_string(current > added_ ? current - added_ : 0));
+    }
+    added_ = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include "state.hpp"
+
+// Serializes changes to the host's huge page pools between supervisors
+#define HUGEPAGES_LOCK STATE_DIR "/hugepages.lock"
+
+// Grows the host's pool of huge pages of one size for as long as a
+// container runs, so the pages its hugetlb limit allows are actually there
+// when it faults them in, rather than only up to whatever the pool held.
+// Reservations add to the pool and take back what they added, so several
+// containers reserving at once each get their own pages.
+class HugepageReservation {
+public:
+    HugepageReservation() = default;
+    ~HugepageReservation() { release(); }
+
+    HugepageReservation(const HugepageReservation &) = delete;
+    HugepageReservation &operator=(const HugepageReservation &) = delete;
+
+    // Adds pages huge pages of size ("2MB", "1GB") to the pool. Fails, and
+    // leaves the pool as it was, if the kernel cannot find that many.
+    bool reserve(const std::string &size, long long pages);
+
+    // Shrinks the pool by what reserve() added. Pages still in use become
+    // surplus pages, freed as soon as they are released.
+    void release();
+
+private:
+    std::string nr_path_;   // nr_hugepages of the reserved size
+    long long added_ = 0;
+};
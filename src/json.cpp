@@ -0,0 +1,119 @@
+#include "json.hpp"
+
+#include <iostream>
+#include <cctype>
+#include <cstdlib>
+
+static void skip_space(const std::string &text, size_t &pos) {
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) {
+        pos++;
+    }
+}
+
+// Reads a string starting at the opening quote, leaving pos after the closing one
+static bool parse_string(const std::string &text, size_t &pos, std::string &value) {
+    if (pos >= text.size() || text[pos] != '"') {
+        return false;
+    }
+    value.clear();
+    for (pos++; pos < text.size(); pos++) {
+        char c = text[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        }
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++pos >= text.size()) {
+            return false;
+        }
+        switch (text[pos]) {
+        case 'n': value += '\n'; break;
+        case 't': value += '\t'; break;
+        case 'r': value += '\r'; break;
+        case 'b': value += '\b'; break;
+        case 'f': value += '\f'; break;
+        case 'u': {
+            // Encoded as UTF-8; surrogate pairs are not combined
+            if (pos + 4 >= text.size()) {
+                return false;
+            }
+            unsigned long code = strtoul(text.substr(pos + 1, 4).c_str(), nullptr, 16);
+            pos += 4;
+            if (code < 0x80) {
+                value += static_cast<char>(code);
+            } else if (code < 0x800) {
+                value += static_cast<char>(0xc0 | (code >> 6));
+                value += static_cast<char>(0x80 | (code & 0x3f));
+            } else {
+                value += static_cast<char>(0xe0 | (code >> 12));
+                value += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                value += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            break;
+        }
+        default: value += text[pos]; break;  // \" \\ \/
+        }
+    }
+    return false;
+}
+
+bool parse_flat_json(const std::string &text, std::map<std::string, JsonValue> &fields) {
+    size_t pos = 0;
+    skip_space(text, pos);
+    if (pos >= text.size() || text[pos] != '{') {
+        std::cerr << "Expected a JSON object: " << text << std::endl;
+        return false;
+    }
+    pos++;
+    skip_space(text, pos);
+    if (pos < text.size() && text[pos] == '}') {
+        return true;
+    }
+    for (;;) {
+        std::string key;
+        JsonValue value;
+        skip_space(text, pos);
+        if (!parse_string(text, pos, key)) {
+            std::cerr << "Expected a key at offset " << pos << ": " << text << std::endl;
+            return false;
+        }
+        skip_space(text, pos);
+        if (pos >= text.size() || text[pos] != ':') {
+            std::cerr << "Expected ':' at offset " << pos << ": " << text << std::endl;
+            return false;
+        }
+        pos++;
+        skip_space(text, pos);
+        value.is_string = pos < text.size() && text[pos] == '"';
+        if (value.is_string) {
+            if (!parse_string(text, pos, value.text)) {
+                std::cerr << "Unterminated string at offset " << pos << ": " << text << std::endl;
+                return false;
+            }
+        } else {
+            // Number or literal: everything up to the next delimiter
+            size_t end = text.find_first_of(",} \t\r\n", pos);
+            value.text = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            if (value.text.empty() || value.text[0] == '{' || value.text[0] == '[') {
+                std::cerr << "Unsupported value for \"" << key << "\": " << text << std::endl;
+                return false;
+            }
+            pos += value.text.size();
+        }
+        fields[key] = value;
+
+        skip_space(text, pos);
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+            continue;
+        }
+        if (pos < text.size() && text[pos] == '}') {
+            return true;
+        }
+        std::cerr << "Expected ',' or '}' at offset " << pos << ": " << text << std::endl;
+        return false;
+    }
+}
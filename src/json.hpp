@@ -0,0 +1,16 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+// A value of a flat JSON object: a string, unescaped, or the text of a
+// number, true, false or null
+struct JsonValue {
+    std::string text;
+    bool is_string = false;
+};
+
+// Parses one flat JSON object, e.g. a line of a .jsonl manifest, into
+// key -> value. Nested objects and arrays are not supported.
+// Returns false (with a message) on malformed input.
+bool parse_flat_json(const std::string &text, std::map<std::string, JsonValue> &fields);
@@ -0,0 +1,44 @@
+#include "ksm.hpp"
+#include "cgroup.hpp"
+
+#include <fstream>
+#include <sys/types.h>
+
+bool ksm_running() {
+    return read_cgroup_value("/sys/kernel/mm/ksm/run") == 1;
+}
+
+bool read_ksm_stats(const std::string &cgroup, KsmStats &stats) {
+    stats = KsmStats();
+    std::ifstream procs(cgroup + "/cgroup.procs");
+    pid_t pid;
+    bool found = false;
+    while (procs >> pid) {
+        // Read in one pass, so the fields belong together. Older kernels
+        // lack some of them; those are left out rather than counted as -1,
+        // and the profit can be negative, so it has no sentinel to test.
+        std::ifstream file("/proc/" + std::to_string(pid) + "/ksm_stat");
+        std::string name;
+        long long value;
+        bool merging = false;
+        while (file >> name >> value) {
+            if (name == "ksm_merging_pages") {
+                stats.merging_pages += value;
+                merging = true;
+            } else if (name == "ksm_zero_pages") {
+                stats.zero_pages += value;
+            } else if (name == "ksm_process_profit") {
+                stats.profit_bytes += value;
+            }
+        }
+        // Without it the process exited since the cgroup was listed
+        found = found || merging;
+    }
+    return found;
+}
+
+std::string format_ksm_stats(const KsmStats &stats) {
+    return " ksm_merging_pages=" + std::to_string(stats.merging_pages) +
+           " ksm_zero_pages=" + std::to_string(stats.zero_pages) +
+           " ksm_profit_bytes=" + std::to_string(stats.profit_bytes);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Kernel samepage merging figures of a container, summed over its
+// processes' /proc/<pid>/ksm_stat
+struct KsmStats {
+    long long merging_pages = 0;  // Pages backed by a page shared with other processes
+    long long zero_pages = 0;     // Empty pages merged with the zero page
+    long long profit_bytes = 0;   // Memory saved, less the cost of KSM's own tracking
+};
+
+// Whether ksmd is running (/sys/kernel/mm/ksm/run is 1); without it,
+// opted-in memory is never scanned
+bool ksm_running();
+
+// Sums ksm_stat over every process in the cgroup. Returns false if there
+// were none to read.
+bool read_ksm_stats(const std::string &cgroup, KsmStats &stats);
+
+// Formats the stats as space separated key=value pairs for the stats stream
+std::string format_ksm_stats(const KsmStats &stats);
@@ -0,0 +1,172 @@
+#include "log.hpp"
+#include "trace.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+// Pipe capacity requested for captured output
+#define LOG_PIPE_SIZE (1024 * 1024)
+
+// Largest chunk moved by one splice call
+#define LOG_CHUNK (256 * 1024)
+
+// A splice into the log slower than this means the disk is not keeping up
+#define LOG_STALL_NS (50 * 1000000ull)
+
+bool create_log_pipe(int fds[2]) {
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        std::cerr << "Error in pipe: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Best effort: unprivileged users are capped by /proc/sys/fs/pipe-max-size
+    fcntl(fds[0], F_SETPIPE_SZ, LOG_PIPE_SIZE);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+bool LogFile::open(const std::string &dir, const std::string &name, uint64_t max_bytes, int files) {
+    mkdir(dir.c_str(), 0755);
+    path_ = dir + "/" + name + ".log";
+    idx_path_ = dir + "/" + name + ".idx";
+    max_bytes_ = max_bytes;
+    files_ = files;
+
+    // No O_APPEND: splice() into append-only files is refused by older kernels
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    null_fd_ = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    index_.open(idx_path_, std::ios::trunc);
+    if (fd_ == -1 || null_fd_ == -1 || !index_.is_open()) {
+        std::cerr << "Failed to open log: " << path_ << " — " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    offset_ = 0;
+    return true;
+}
+
+bool LogFile::rotate() {
+    ::close(fd_);
+    index_.close();
+
+    // <name>.log.<files> falls off the end; everything else shifts up by one
+    for (int i = files_ - 1; i >= 1; i--) {
+        std::string from = path_ + "." + std::to_string(i);
+        std::string to = path_ + "." + std::to_string(i + 1);
+        rename(from.c_str(), to.c_str());
+        rename((idx_path_ + "." + std::to_string(i)).c_str(), (idx_path_ + "." + std::to_string(i + 1)).c_str());
+    }
+    if (files_ > 0) {
+        rename(path_.c_str(), (path_ + ".1").c_str());
+        rename(idx_path_.c_str(), (idx_path_ + ".1").c_str());
+    }
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    index_.open(idx_path_, std::ios::trunc);
+    offset_ = 0;
+    if (fd_ == -1) {
+        std::cerr << "Failed to reopen log: " << path_ << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ssize_t LogFile::discard(int pipe_fd) {
+    ssize_t n = splice(pipe_fd, nullptr, null_fd_, nullptr, LOG_CHUNK, SPLICE_F_NONBLOCK);
+    if (n > 0) {
+        dropped_ += n;
+    }
+    return n;
+}
+
+bool LogFile::drain(int pipe_fd) {
+    for (;;) {
+        // Once the log cannot be written any more, the pipe is still
+        // emptied: nobody else reads it, and a full pipe would block the
+        // container on its next write
+        if (failed_) {
+            ssize_t n = discard(pipe_fd);
+            if (n == 0) {
+                return false;  // EOF: every writer has exited
+            }
+            if (n == -1) {
+                return errno == EAGAIN || errno == EINTR;
+            }
+            continue;
+        }
+
+        // A full pipe while the disk is stalling means the container is
+        // blocked on us: discard the backlog rather than let it wait on the
+        // disk. A full pipe alone is just a burst we are about to catch up on.
+        int pending = 0;
+        int capacity = fcntl(pipe_fd, F_GETPIPE_SZ);
+        if (disk_stalled_ && ioctl(pipe_fd, FIONREAD, &pending) == 0 && capacity > 0 && pending >= capacity) {
+            ssize_t n = splice(pipe_fd, nullptr, null_fd_, nullptr, pending, SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                dropped_ += n;
+                timespec now;
+                clock_gettime(CLOCK_REALTIME, &now);
+                index_ << now.tv_sec << "." << std::setw(9) << std::setfill('0') << now.tv_nsec << std::setfill(' ')
+                       << " " << offset_ << " 0 dropped=" << n << "\n";
+                continue;
+            }
+        }
+
+        uint64_t room = max_bytes_ - offset_;
+        if (fd_ == -1 || (max_bytes_ && room == 0 && !rotate())) {
+            failed_ = true;
+            continue;
+        }
+        if (max_bytes_ && room == 0) {
+            room = max_bytes_;
+        }
+        size_t chunk = max_bytes_ ? std::min<uint64_t>(room, LOG_CHUNK) : LOG_CHUNK;
+
+        loff_t offset = offset_;
+        uint64_t start = monotonic_ns();
+        ssize_t n = splice(pipe_fd, nullptr, fd_, &offset, chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        disk_stalled_ = monotonic_ns() - start > LOG_STALL_NS;
+        if (n == 0) {
+            index_.flush();
+            return false;  // EOF: every writer has exited
+        }
+        if (n == -1) {
+            index_.flush();
+            if (errno == EAGAIN || errno == EINTR) {
+                return true;
+            }
+            std::cerr << "Error in splice: " << path_ << " — " << strerror(errno) << ", discarding further output"
+                      << std::endl;
+            failed_ = true;
+            continue;
+        }
+
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        index_ << now.tv_sec << "." << std::setw(9) << std::setfill('0') << now.tv_nsec << std::setfill(' ')
+               << " " << offset_ << " " << n << "\n";
+        offset_ += n;
+        written_ += n;
+    }
+}
+
+void LogFile::close() {
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (null_fd_ != -1) {
+        ::close(null_fd_);
+        null_fd_ = -1;
+    }
+    if (index_.is_open()) {
+        index_.close();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <sys/types.h>
+
+// One captured output stream of a container, written to <dir>/<name>.log
+// and rotated to <name>.log.1 ... <name>.log.<files> once it reaches
+// max_bytes. Data is moved from the container's pipe with splice(), so it
+// never passes through user space.
+//
+// Next to each log, <name>.idx records one "seconds.nanoseconds offset length"
+// line (CLOCK_REALTIME) per chunk, giving every byte a timestamp without
+// rewriting the data.
+//
+// The container never waits on a slow disk: if the pipe is full and the
+// last splice into the log stalled, the backlog is discarded and counted
+// instead of letting the container's writes block behind the disk. After a
+// failed write or rotation everything is discarded and counted that way.
+class LogFile {
+public:
+    LogFile() = default;
+    ~LogFile() { close(); }
+
+    LogFile(const LogFile &) = delete;
+    LogFile &operator=(const LogFile &) = delete;
+
+    bool open(const std::string &dir, const std::string &name, uint64_t max_bytes, int files);
+
+    // Moves whatever is in the (non-blocking) pipe into the log. Returns
+    // false once the pipe reports EOF; the pipe must be drained until then.
+    bool drain(int pipe_fd);
+
+    uint64_t written() const { return written_; }
+    uint64_t dropped() const { return dropped_; }
+
+    void close();
+
+private:
+    bool rotate();
+
+    // Splices a chunk of the pipe into /dev/null and counts it as dropped
+    ssize_t discard(int pipe_fd);
+
+    std::string path_;      // <dir>/<name>.log
+    std::string idx_path_;  // <dir>/<name>.idx
+    uint64_t max_bytes_ = 0;
+    int files_ = 0;
+    int fd_ = -1;
+    int null_fd_ = -1;      // /dev/null, where dropped data is spliced
+    uint64_t offset_ = 0;   // Size of the current log file
+    bool disk_stalled_ = false;
+    bool failed_ = false;   // Writing or rotating the log failed; output is discarded
+    std::ofstream index_;
+    uint64_t written_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+// Creates a pipe for a container's output stream, sized to absorb bursts.
+// The read end is non-blocking for the supervisor; both ends are close-on-exec.
+bool create_log_pipe(int fds[2]);
@@ -1,138 +1,719 @@
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <csignal>
 #include <errno.h>
 #include <fstream>
+#include <algorithm>
+#include <climits>
 #include "include/cxxopts.hpp" // For parsing command line options
+#include "batch.hpp"
+#include "bench.hpp"
+#include "cgroup.hpp"
+#include "container.hpp"
+#include "event_loop.hpp"
+#include "exec.hpp"
+#include "hugepages.hpp"
+#include "ksm.hpp"
+#include "log.hpp"
+#include "net.hpp"
+#include "netns_pool.hpp"
+#include "perf.hpp"
+#include "pipeline.hpp"
+#include "pod.hpp"
+#include "pressure.hpp"
+#include "profiler.hpp"
+#include "shm.hpp"
+#include "state.hpp"
+#include "tenant.hpp"
+#include "trace.hpp"
 
 
-// Size of stack for the child process
-#define STACK_SIZE 1024 * 1024 // 1 MB stack
+// Adds the options shared by "run" and "update" that map onto cgroup limits
+void add_limit_options(cxxopts::Options &options) {
+    options.add_options()
+        ("m,mem", "Memory limit (MB)", cxxopts::value<long long>())
+        ("p,cpu", "CPU limit (shares)", cxxopts::value<int>())
+        ("cpu-period", "cpu.max period the CPU limit is enforced over (us)", cxxopts::value<int>())
+        ("cpuset-cpus", "CPUs the container may run on (e.g. 0-3,6)", cxxopts::value<std::string>())
+        ("cpuset-mems", "Memory nodes the container may allocate from (e.g. 0)", cxxopts::value<std::string>())
+        ("io", "io.max line (e.g. \"8:0 rbps=1048576 wbps=max\")", cxxopts::value<std::string>())
+        ("cpu-weight", "Share of CPU relative to its siblings under contention (1-10000, default 100)", cxxopts::value<int>())
+        ("io-weight", "Share of IO relative to its siblings under contention (1-10000, default 100)", cxxopts::value<int>())
+        ("hugepages", "Huge pages the container may use (hugetlb.<size>.max, in pages)", cxxopts::value<long long>())
+        ("hugepage-size", "Size of those huge pages (2MB or 1GB)", cxxopts::value<std::string>());
+}
 
-void write_to_file(const std::string &path, const std::string &value) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open: " << path << " — " << strerror(errno) << std::endl;
-        exit(1);
+// Fills limits from whichever limit options were given
+Limits parse_limits(const cxxopts::ParseResult &result) {
+    Limits limits;
+    if (result.count("mem")) {
+        limits.mem_mb = result["mem"].as<long long>();    //[TODO] Add support for prefixes so that 1GB = 1024MB
+    }
+    if (result.count("cpu")) {
+        limits.cpu_pct = result["cpu"].as<int>();
+    }
+    if (result.count("cpu-period")) {
+        limits.cpu_period_us = result["cpu-period"].as<int>();
+    }
+    if (result.count("cpuset-cpus")) {
+        limits.cpuset_cpus = result["cpuset-cpus"].as<std::string>();
+    }
+    if (result.count("cpuset-mems")) {
+        limits.cpuset_mems = result["cpuset-mems"].as<std::string>();
+    }
+    if (result.count("io")) {
+        limits.io_max = result["io"].as<std::string>();
+    }
+    if (result.count("cpu-weight")) {
+        limits.cpu_weight = result["cpu-weight"].as<int>();
+    }
+    if (result.count("io-weight")) {
+        limits.io_weight = result["io-weight"].as<int>();
+    }
+    if (result.count("hugepages")) {
+        limits.hugetlb_pages = result["hugepages"].as<long long>();
+    }
+    if (result.count("hugepage-size")) {
+        limits.hugetlb_size = result["hugepage-size"].as<std::string>();
     }
-    file << value;
-    file.close();
+    return limits;
 }
 
-// Child process function: Runs in the new namespace, executes command
-int child_process(void *arg) {
-    // [TODO] Automatically install image if not present
-    const std::string rootfs = "./images/ubuntu"; // Path to the root filesystem
-
-    // Change the root directory of the container
-    if (chroot(rootfs.c_str()) == -1) {
-        std::cerr << "Error in chroot: " << strerror(errno) << std::endl;
-        exit(1);
-    }
-
-    // Change the working directory to "/"
-    chdir("/");
-    // Set PATH Variables for the container
-    setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin:/usr/games", 1);
-    
-    // Execute the command passed by the user
-    char *const cmd[] = {(char*)"sh", (char*)"-c", (char*)arg, NULL}; // Run the command in a shell
-    execvp(cmd[0], cmd);
-
-    // If execvp fails
-    std::cerr << "Error in execvp: " << strerror(errno) << std::endl;
-    return 1;
-}
+// dockher [run] --cmd <cmd> --mem <MB> --cpu <%>
+int run_container(int argc, char *argv[]) {
+    uint64_t parse_start = monotonic_ns();
 
-int main(int argc, char *argv[]) {
-    try {
-        // Create the option parser
-        cxxopts::Options options("dockher", "Mini Docker in C++");
-
-        // Define the CLI options
-        // [TODO] Try to set default values for these
-        options.add_options()
-            ("c,cmd", "Command to run inside container", cxxopts::value<std::string>())
-            ("m,mem", "Memory limit (MB)", cxxopts::value<int>())
-            ("p,cpu", "CPU limit (shares)", cxxopts::value<int>())
-            ("h,help", "Print usage");
-
-        // Parse the command lines
-        auto result = options.parse(argc, argv);
-
-        // If help is requested, print usage and exit
-        if (result.count("help")) {
-            std::cout << options.help() << std::endl;
-            return 0;
-        }
-
-        // Get values from the parsed options
-        std::string cmd = result["cmd"].as<std::string>();
-        int mem_limit = result["mem"].as<int>();    //[TODO] Add support for prefixes so that 1GB = 1024MB
-        int cpu_limit = result["cpu"].as<int>();
-
-        //Input Validation
-        if (cpu_limit < 0 || cpu_limit > 100) {
-            std::cerr << "CPU limit must be between 0 and 100 (%)" << std::endl;
+    // Create the option parser
+    cxxopts::Options options("dockher", "Mini Docker in C++");
+
+    // Define the CLI options
+    // [TODO] Try to set default values for these
+    options.add_options()
+        ("c,cmd", "Command to run inside container", cxxopts::value<std::string>())
+        ("perf-counters", "Count cycles, instructions, cache misses, context switches and page faults for the container")
+        ("stats", "Print resource usage every N ms (0 = off)", cxxopts::value<long>()->default_value("0"))
+        ("profile", "Sample call stacks of the whole container and write folded stacks to this file", cxxopts::value<std::string>())
+        ("profile-freq", "Sampling frequency for --profile (Hz)", cxxopts::value<int>()->default_value("99"))
+        ("log-dir", "Capture stdout/stderr into rotating stdout.log/stderr.log files in this directory", cxxopts::value<std::string>())
+        ("log-size", "Rotate a log once it reaches this size (MB)", cxxopts::value<long>()->default_value("10"))
+        ("log-files", "Rotated logs to keep per stream", cxxopts::value<int>()->default_value("3"))
+        ("tenant", "Run in this tenant's cgroup, under " TENANT_SLICE " (see dockher tenant)", cxxopts::value<std::string>())
+        ("sched", "Scheduling policy: other, batch (throughput jobs) or idle (only when nothing else runs)", cxxopts::value<std::string>()->default_value("other"))
+        ("nice", "Nice level of the container's processes (-20 to 19)", cxxopts::value<int>()->default_value("0"))
+        ("slice", "EEVDF time slice the container's processes ask for (us, 100-100000); shorter = lower latency", cxxopts::value<long>())
+        ("core-sched", "Give the container its own core scheduling cookie, so it never shares SMT siblings with other containers")
+        ("ns", "Namespaces to create, comma-separated (pid, mnt, net, ipc, uts, user, cgroup, time, or none); the rest are shared with the host", cxxopts::value<std::string>()->default_value("pid,mnt"))
+        ("net", "Connect the container to the local bridge network (bridge)", cxxopts::value<std::string>())
+        ("subnet", "Subnet of the bridge network; the bridge takes its first address", cxxopts::value<std::string>()->default_value(NET_DEFAULT_SUBNET))
+        ("mtu", "MTU of the container's link to the bridge", cxxopts::value<int>()->default_value(std::to_string(NET_DEFAULT_MTU)))
+        ("no-gro", "Disable generic receive offload on the container's link")
+        ("no-gso", "Disable generic segmentation offload on the container's link")
+        ("shm-size", "Give the container a /dev/shm of this size (MB)", cxxopts::value<long long>())
+        ("shm-group", "Share /dev/shm with every container run with the same group name", cxxopts::value<std::string>())
+        ("shm-hugetlb", "Back /dev/shm with huge pages (hugetlbfs) instead of tmpfs")
+        ("reserve-hugepages", "Add the --hugepages to the host's huge page pool while the container runs")
+        ("hugetlbfs", "Mount a hugetlbfs with pages of --hugepage-size at this path in the container", cxxopts::value<std::string>())
+        ("timeout", "Stop the container if it is still running after this long (s, 0 = never)", cxxopts::value<double>()->default_value("0"))
+        ("stop-grace", "Time a stopped container gets to exit after SIGTERM before it is killed (s)", cxxopts::value<double>()->default_value("10"))
+        ("no-init", "Run the command as PID 1 itself instead of under dockher's minimal init")
+        ("ksm", "Let the kernel merge identical memory pages of the container with other processes' (KSM)")
+        ("thp", "Transparent huge pages for the container: inherit (the host's setting), madvise or never", cxxopts::value<std::string>()->default_value("inherit"))
+        ("max-cpu-pressure", "Hold the launch while CPU stall (PSI some avg10) is above this (%)", cxxopts::value<double>())
+        ("max-mem-pressure", "Hold the launch while memory stall (PSI some avg10) is above this (%)", cxxopts::value<double>())
+        ("max-io-pressure", "Hold the launch while IO stall (PSI some avg10) is above this (%)", cxxopts::value<double>())
+        ("pressure-timeout", "Give up on a launch held back by pressure after this long (ms)", cxxopts::value<long>()->default_value("30000"))
+        ("trace", "Write timestamps of every lifecycle phase to this file", cxxopts::value<std::string>())
+        ("trace-format", "Trace file format: json (Chrome trace) or binary", cxxopts::value<std::string>()->default_value("json"))
+        ("h,help", "Print usage");
+    add_limit_options(options);
+
+    // Parse the command lines
+    auto result = options.parse(argc, argv);
+
+    // If help is requested, print usage and exit
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    // Get values from the parsed options
+    std::string cmd = result["cmd"].as<std::string>();
+    Limits limits = parse_limits(result);
+    if (limits.mem_mb == -1 || limits.cpu_pct == -1) {
+        std::cerr << "Both --mem and --cpu are required" << std::endl;
+        return 1;
+    }
+
+    //Input Validation
+    if (!validate_limits(limits)) {
+        return 1;
+    }
+
+    std::string trace_path = result.count("trace") ? result["trace"].as<std::string>() : "";
+    std::string trace_format = result["trace-format"].as<std::string>();
+    if (trace_format != "json" && trace_format != "binary") {
+        std::cerr << "Trace format must be json or binary" << std::endl;
+        return 1;
+    }
+    Trace trace;
+    trace.add("option parsing", parse_start, monotonic_ns(), getpid());
+
+    // Print the parsed values for verification
+    std::cout << "Parsed values:\n";
+    std::cout << "Command to run: " << cmd << std::endl;
+    std::cout << "Memory limit: " << limits.mem_mb << " MB" << std::endl;
+    std::cout << "CPU limit: " << limits.cpu_pct << " shares" << std::endl;
+
+    // Containers of a tenant share its weights and memory budget
+    std::string cgroup_parent = CGROUP_ROOT;
+    if (result.count("tenant") && !ensure_tenant(result["tenant"].as<std::string>(), cgroup_parent)) {
+        return 1;
+    }
+
+    // Hold the launch while the host is stalling, before committing anything to it
+    PressureThresholds thresholds;
+    thresholds.cpu = result.count("max-cpu-pressure") ? result["max-cpu-pressure"].as<double>() : -1;
+    thresholds.memory = result.count("max-mem-pressure") ? result["max-mem-pressure"].as<double>() : -1;
+    thresholds.io = result.count("max-io-pressure") ? result["max-io-pressure"].as<double>() : -1;
+    thresholds.timeout_ms = result["pressure-timeout"].as<long>();
+    if (thresholds.enabled()) {
+        uint64_t admission_start = monotonic_ns();
+        PressureGate gate(thresholds, cgroup_parent);
+        std::string reason;
+        bool admitted = gate.wait(reason);
+        if (!admitted) {
+            std::cerr << "Launch rejected after " << thresholds.timeout_ms << " ms: " << reason << std::endl;
+            return 1;
+        }
+        if (gate.stalls()) {
+            std::cout << "Launch held for " << gate.held_ns() / 1000000 << " ms: " << reason << std::endl;
+        }
+        trace.add("admission", admission_start, monotonic_ns(), getpid());
+    }
+
+    // Clone the container into its cgroup; it waits for us before exec
+    ContainerConfig config;
+    config.cmd = cmd;
+    config.limits = limits;
+    config.cgroup_parent = cgroup_parent;
+    if (!parse_sched_policy(result["sched"].as<std::string>(), config.sched.policy)) {
+        return 1;
+    }
+    config.sched.nice = result["nice"].as<int>();
+    config.sched.slice_us = result.count("slice") ? result["slice"].as<long>() : 0;
+    config.sched.core_cookie = result["core-sched"].as<bool>();
+    if (!validate_sched(config.sched) || !parse_thp_policy(result["thp"].as<std::string>(), config.thp)) {
+        return 1;
+    }
+    config.ksm = result["ksm"].as<bool>();
+    config.init = !result["no-init"].as<bool>();
+    if (result["timeout"].as<double>() < 0 || result["stop-grace"].as<double>() < 0) {
+        std::cerr << "--timeout and --stop-grace must not be negative" << std::endl;
+        return 1;
+    }
+    // Checked up front, since a negative size would wrap into a huge byte
+    // count below and turn rotation off
+    if (result["log-size"].as<long>() < 1 || result["log-size"].as<long>() > 1024 * 1024 ||
+        result["log-files"].as<int>() < 1) {
+        std::cerr << "--log-size must be between 1 and 1048576 (MB) and --log-files at least 1" << std::endl;
+        return 1;
+    }
+    if (config.ksm && !ksm_running()) {
+        std::cerr << "Warning: KSM is not running, nothing will be merged (echo 1 > /sys/kernel/mm/ksm/run)" << std::endl;
+    }
+    if (!parse_namespaces(result["ns"].as<std::string>(), config.namespaces)) {
+        return 1;
+    }
+
+    // Output goes to pipes we drain into the log files, instead of our terminal
+    std::string log_dir = result.count("log-dir") ? result["log-dir"].as<std::string>() : "";
+    const char *const stream_names[] = {"stdout", "stderr"};
+    LogFile logs[2];
+    int log_pipes[2][2] = {{-1, -1}, {-1, -1}};
+    if (!log_dir.empty()) {
+        uint64_t log_bytes = static_cast<uint64_t>(result["log-size"].as<long>()) * 1024 * 1024;
+        for (int i = 0; i < 2; i++) {
+            if (!create_log_pipe(log_pipes[i]) || !logs[i].open(log_dir, stream_names[i], log_bytes, result["log-files"].as<int>())) {
+                return 1;
+            }
+        }
+        config.stdout_fd = log_pipes[0][1];
+        config.stderr_fd = log_pipes[1][1];
+    }
+
+    // Shared memory volume, joined for as long as the container runs
+    ShmVolume shm;
+    if (result.count("shm-size") || result.count("shm-group")) {
+        // Without a group the volume is private to this run
+        std::string group = result.count("shm-group") ? result["shm-group"].as<std::string>()
+                                                      : "private_" + std::to_string(getpid());
+        long long shm_mb = result.count("shm-size") ? result["shm-size"].as<long long>() : 64;
+        if (!shm.open(group, shm_mb, result["shm-hugetlb"].as<bool>())) {
             return 1;
         }
+        config.shm_path = shm.path();
+    }
 
-        // Print the parsed values for verification
-        std::cout << "Parsed values:\n";
-        std::cout << "Command to run: " << cmd << std::endl;
-        std::cout << "Memory limit: " << mem_limit << " MB" << std::endl;
-        std::cout << "CPU limit: " << cpu_limit << " shares" << std::endl;
+    // Huge pages: the limit alone only caps what the container may take
+    // from the pool, so they can also be added to the pool for this run
+    HugepageReservation hugepages;
+    if (result["reserve-hugepages"].as<bool>()) {
+        if (limits.hugetlb_pages <= 0) {
+            std::cerr << "--reserve-hugepages needs --hugepages" << std::endl;
+            return 1;
+        }
+        if (!hugepages.reserve(limits.hugetlb_size, limits.hugetlb_pages)) {
+            return 1;
+        }
+    }
+    if (result.count("hugetlbfs")) {
+        config.hugetlbfs_path = result["hugetlbfs"].as<std::string>();
+        if (config.hugetlbfs_path.empty() || config.hugetlbfs_path[0] != '/') {
+            std::cerr << "--hugetlbfs must be an absolute path in the container" << std::endl;
+            return 1;
+        }
+        if (hugepage_bytes(limits.hugetlb_size) == -1) {
+            std::cerr << "Huge page size must be like 2MB or 1GB" << std::endl;
+            return 1;
+        }
+    }
 
-        // Allocate memory for the child stack
-        char *stack = (char *)malloc(STACK_SIZE);
-        if (!stack) {
-            std::cerr << "Failed to allocate stack for child process" << std::endl;
+    // Bridge networking needs a network namespace of its own
+    bool network = false;
+    NetConfig net_config;
+    if (result.count("net")) {
+        if (result["net"].as<std::string>() != "bridge") {
+            std::cerr << "Network mode must be bridge" << std::endl;
             return 1;
         }
+        network = true;
+        config.namespaces |= CLONE_NEWNET;
+        net_config.subnet = result["subnet"].as<std::string>();
+        if (!validate_subnet(net_config.subnet)) {
+            return 1;
+        }
+        net_config.mtu = result["mtu"].as<int>();
+        net_config.gro = !result["no-gro"].as<bool>();
+        net_config.gso = !result["no-gso"].as<bool>();
+    }
+
+    // Take a ready network namespace from the pool rather than creating one
+    // on the launch path. The container cannot join one owned by the host's
+    // user namespace from a new one, so those still get a fresh namespace.
+    int netns_fd = -1;
+    if ((config.namespaces & CLONE_NEWNET) && !(config.namespaces & CLONE_NEWUSER)) {
+        uint64_t claim_start = monotonic_ns();
+        netns_fd = claim_netns();
+        if (netns_fd != -1) {
+            trace.add("netns claim", claim_start, monotonic_ns(), getpid());
+            config.join_namespaces.emplace_back(CLONE_NEWNET, netns_fd);
+            config.namespaces &= ~CLONE_NEWNET;
+        }
+    }
+
+    Container container;
+    bool created = create_container(config, container);
+    // Only the container may hold the write ends, so we see EOF when it is done
+    for (auto &log_pipe : log_pipes) {
+        if (log_pipe[1] != -1) {
+            close(log_pipe[1]);
+        }
+    }
+    if (!created) {
+        if (netns_fd != -1) {
+            close(netns_fd);
+        }
+        return 1;
+    }
+    std::cout << "Container id: " << container.pid << std::endl;
 
-        // The child process will run in a new PID and mount namespace
-        pid_t pid = clone(child_process, stack + STACK_SIZE, CLONE_NEWPID | CLONE_NEWNS | SIGCHLD, (void*)cmd.c_str());
-        if (pid == -1) {
-            std::cerr << "Error in clone: " << strerror(errno) << std::endl;
+    // Connect the container's network namespace to the bridge before it
+    // starts. A pooled namespace is only joined once the child runs, so it
+    // is configured through our descriptor rather than the child's.
+    NetEndpoint endpoint;
+    bool pooled_netns = netns_fd != -1;
+    if (network) {
+        uint64_t attach_start = monotonic_ns();
+        if (netns_fd == -1) {
+            netns_fd = open(("/proc/" + std::to_string(container.pid) + "/ns/net").c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        if (netns_fd == -1 || !attach_network(container.pid, netns_fd, net_config, endpoint)) {
+            if (netns_fd != -1) {
+                close(netns_fd);
+            }
+            destroy_container(container);
             return 1;
         }
+        trace.add("network attach", attach_start, monotonic_ns(), getpid());
+        std::cout << "IP address: " << endpoint.address << std::endl;
+    }
+    // The container holds its namespace from here on
+    if (netns_fd != -1) {
+        close(netns_fd);
+    }
+
+    // Counters attach to the cgroup before the workload runs its first instruction
+    PerfCounters perf;
+    bool perf_enabled = result["perf-counters"].as<bool>() && perf.open(container.cgroup);
+    Profiler profiler;
+    std::string profile_path = result.count("profile") ? result["profile"].as<std::string>() : "";
+    if (!profile_path.empty() && !profiler.open(container.cgroup, config.rootfs, result["profile-freq"].as<int>())) {
+        profile_path.clear();
+    }
+
+    // Record the container so "dockher update" can find it
+    ContainerState state;
+    state.pid = container.pid;
+    state.supervisor = getpid();
+    state.cgroup = container.cgroup;
+    state.rootfs = config.rootfs;
+    state.cmd = cmd;
+    state.thp = result["thp"].as<std::string>();
+    state.ksm = config.ksm;
+    save_state(state);
 
-    // Only parent reaches here
-    std::string pid_str = std::to_string(pid);
+    if (!start_container(container)) {
+        remove_state(state.pid);
+        destroy_container(container);
+        detach_network(endpoint);
+        if (!trace_path.empty()) {
+            trace.add(container.spans);
+            trace.write(trace_path, trace_format);
+        }
+        return 1;
+    }
 
-    // Unified cgroup v2 directory
-    std::string cgroup_path = "/sys/fs/cgroup/dockher_" + pid_str;
-    mkdir(cgroup_path.c_str(), 0755); // Create cgroup directory
+    // Replace the namespace we took, now that the container is running.
+    // Used ones are not recycled: whatever the container configured in
+    // them would leak into the next one.
+    if (pooled_netns) {
+        refill_netns_pool();
+    }
 
-    // Write memory limit (in bytes)
-    write_to_file(cgroup_path + "/memory.max", std::to_string(mem_limit * 1024 * 1024));
+    // Supervise until the container exits, printing stats periodically if asked
+    EventLoop loop;
+    loop.add(container.pidfd, [&loop]() { loop.stop(); });
 
-    // Write CPU limit: quota and period in microseconds
-    // Example: "50000 100000" = 50ms out of every 100ms => 50% CPU
-    int cpu_period_us = 100000; // 100ms default period
-    int cpu_quota_us = (cpu_limit * cpu_period_us) / 100; // e.g., 50% => 50000
+    // Stopping sends the signal to the container's init, which passes it on
+    // to the command. Whatever is left of the container once the grace
+    // period is over is killed with cgroup.kill.
+    long grace_ms = static_cast<long>(result["stop-grace"].as<double>() * 1000);
+    bool stopping = false;
+    auto stop = [&](int sig) {
+        kill(container.pid, sig);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+        loop.add_timer(std::max(grace_ms, 1L), [&]() {
+            std::cerr << "Killing container " << container.pid << " after the " << grace_ms << " ms grace period" << std::endl;
+            kill_cgroup(container.cgroup);
+        }, false);
+    };
 
-    // If cpu_limit is 0, allow max cpu allocation
-    std::string cpu_max_value = (cpu_limit == 0) ? "max" : std::to_string(cpu_quota_us) + " " + std::to_string(cpu_period_us);
-    write_to_file(cgroup_path + "/cpu.max", cpu_max_value);
+    // A hung command would otherwise keep its cgroup and quota forever
+    double timeout_s = result["timeout"].as<double>();
+    bool timed_out = false;
+    if (timeout_s > 0) {
+        loop.add_timer(static_cast<long>(timeout_s * 1000), [&]() {
+            std::cerr << "Container " << container.pid << " timed out after " << timeout_s << " s, stopping it" << std::endl;
+            timed_out = true;
+            stop(SIGTERM);
+        }, false);
+    }
 
-    // Add the child process to the cgroup
-    write_to_file(cgroup_path + "/cgroup.procs", pid_str);
+    // Ctrl-C and SIGTERM stop the container, and we exit once it does. A
+    // second one kills it outright, without waiting for the grace period.
+    sigset_t forwarded;
+    sigemptyset(&forwarded);
+    sigaddset(&forwarded, SIGINT);
+    sigaddset(&forwarded, SIGTERM);
+    sigprocmask(SIG_BLOCK, &forwarded, nullptr);
+    int signal_fd = signalfd(-1, &forwarded, SFD_CLOEXEC | SFD_NONBLOCK);
+    int signals_received = 0;
+    if (signal_fd == -1) {
+        std::cerr << "Error in signalfd: " << strerror(errno) << std::endl;
+    } else {
+        loop.add(signal_fd, [&]() {
+            signalfd_siginfo info;
+            while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                if (++signals_received > 1) {
+                    std::cerr << "Killing container " << container.pid << std::endl;
+                    kill_cgroup(container.cgroup);
+                } else {
+                    std::cerr << "Forwarding " << strsignal(info.ssi_signo) << " to container " << container.pid << std::endl;
+                    stop(info.ssi_signo);
+                }
+            }
+        });
+    }
+    long stats_ms = result["stats"].as<long>();
+    KsmStats ksm, ksm_peak;
+    if (stats_ms > 0) {
+        loop.add_timer(stats_ms, [&]() {
+            bool ksm_read = config.ksm && read_ksm_stats(container.cgroup, ksm);
+            std::cerr << "stats " << container.pid
+                      << ": cpu_usage_us=" << read_cgroup_stat(container.cgroup + "/cpu.stat", "usage_usec")
+                      << " memory_bytes=" << read_cgroup_value(container.cgroup + "/memory.current")
+                      << (perf_enabled ? format_perf_totals(perf.read()) : "")
+                      << (ksm_read ? format_ksm_stats(ksm) : "") << std::endl;
+            if (ksm_read && ksm.merging_pages >= ksm_peak.merging_pages) {
+                ksm_peak = ksm;
+            }
+        });
+    }
+    if (config.ksm) {
+        // ksm_stat goes with the processes, so the exit report can only
+        // show the last reading before they went
+        loop.add_timer(1000, [&]() {
+            if (read_ksm_stats(container.cgroup, ksm) && ksm.merging_pages >= ksm_peak.merging_pages) {
+                ksm_peak = ksm;
+            }
+        });
+    }
+    for (int i = 0; i < 2 && !log_dir.empty(); i++) {
+        int fd = log_pipes[i][0];
+        LogFile *log = &logs[i];
+        loop.add(fd, [&loop, fd, log]() {
+            if (!log->drain(fd)) {
+                loop.remove(fd);
+            }
+        });
+    }
+    if (!profile_path.empty()) {
+        // Keep the per-CPU ring buffers from overflowing
+        loop.add_timer(100, [&profiler]() { profiler.drain(); });
+    }
+    loop.run();
 
     // Wait for the child process to finish
-    waitpid(pid, nullptr, 0);
+    int status = wait_container(container);
+    if (signal_fd != -1) {
+        close(signal_fd);
+    }
+    for (int i = 0; i < 2 && !log_dir.empty(); i++) {
+        // Whatever was written before the exit is still in the pipe
+        logs[i].drain(log_pipes[i][0]);
+        close(log_pipes[i][0]);
+        logs[i].close();
+        std::cout << "Log " << stream_names[i] << ": " << logs[i].written() << " bytes";
+        if (logs[i].dropped()) {
+            std::cout << " (" << logs[i].dropped() << " bytes dropped while the disk fell behind or failed)";
+        }
+        std::cout << std::endl;
+    }
+    if (perf_enabled) {
+        print_perf_totals(perf.read());
+    }
+    if (config.ksm) {
+        std::cout << "KSM: " << ksm_peak.merging_pages << " pages merged at peak (" << ksm_peak.zero_pages
+                  << " with the zero page), " << ksm_peak.profit_bytes / 1024 << " KB saved" << std::endl;
+    }
+    if (!profile_path.empty()) {
+        profiler.drain();
+        if (profiler.write_folded(profile_path)) {
+            std::cout << "Profile: " << profiler.samples() << " samples (" << profiler.lost()
+                      << " lost) written to " << profile_path << std::endl;
+        }
+    }
 
     // Cleanup
-    rmdir(cgroup_path.c_str());
+    remove_state(state.pid);
+    destroy_container(container);
+    detach_network(endpoint);
+    if (!trace_path.empty()) {
+        trace.add(container.spans);
+        trace.write(trace_path, trace_format);
+    }
+
+    // The container's exit code is ours, as with a shell, or 124 as with
+    // timeout(1) if it had to be stopped
+    if (status == -1) {
+        return 1;
+    }
+    if (timed_out) {
+        return 124;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+// dockher update <id> [--mem <MB>] [--cpu <%>] [--cpuset-cpus ..] [--cpuset-mems ..] [--io ..]
+// Changes the limits of a running container in place
+int update_container(int argc, char *argv[]) {
+    cxxopts::Options options("dockher update", "Change the resource limits of a running container");
+    options.add_options()
+        ("id", "Container id", cxxopts::value<std::string>())
+        ("h,help", "Print usage");
+    add_limit_options(options);
+    options.parse_positional({"id"});
+    options.positional_help("<id>");
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("id")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+
+    // --hugepage-size only says which pages --hugepages counts
+    bool any = false;
+    for (const char *name : {"mem", "cpu", "cpu-period", "cpuset-cpus", "cpuset-mems", "io", "cpu-weight", "io-weight", "hugepages"}) {
+        any = any || result.count(name);
+    }
+    if (!any) {
+        std::cerr << "No limit to update given" << std::endl;
+        std::cout << options.help() << std::endl;
+        return 1;
+    }
+
+    ContainerState state;
+    if (!load_state(result["id"].as<std::string>(), state)) {
+        return 1;
+    }
+
+    // Validates everything before the first write, and rolls back on a failed write
+    Limits limits = parse_limits(result);
+
+    // cpu.max is "quota period" and both are written together. A new CPU
+    // limit alone keeps the period the container was started with; a new
+    // period alone keeps the share of CPU the current quota gives.
+    if (result.count("cpu") != result.count("cpu-period")) {
+        std::string cpu_max;
+        char quota[32] = "";
+        long period = 0;
+        if (!read_file(state.cgroup + "/cpu.max", cpu_max) || sscanf(cpu_max.c_str(), "%31s %ld", quota, &period) != 2 ||
+            period <= 0) {
+            std::cerr << "Failed to read cpu.max of container " << state.pid << std::endl;
+            return 1;
+        }
+        if (result.count("cpu")) {
+            limits.cpu_period_us = period;
+        } else if (strcmp(quota, "max") == 0) {
+            limits.cpu_pct = 0;
+        } else {
+            // At least 1%, as 0 would lift the limit
+            limits.cpu_pct = std::max(1, static_cast<int>((strtoll(quota, nullptr, 10) * 100 + period / 2) / period));
+        }
+    }
+    if (!apply_limits(state.cgroup, limits)) {
+        std::cerr << "Limits of container " << state.pid << " left unchanged" << std::endl;
+        return 1;
+    }
+    std::cout << "Updated limits of container " << state.pid << std::endl;
+    return 0;
+}
+
+// dockher stop <id> [--grace <s>]
+// Sends the container SIGTERM and kills whatever is left of it after the grace period
+int stop_container(int argc, char *argv[]) {
+    cxxopts::Options options("dockher stop", "Stop a running container");
+    options.add_options()
+        ("id", "Container id", cxxopts::value<std::string>())
+        ("g,grace", "Time the container gets to exit before it is killed (s)", cxxopts::value<double>()->default_value("10"))
+        ("h,help", "Print usage");
+    options.parse_positional({"id"});
+    options.positional_help("<id>");
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("id")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+
+    // poll() waits forever on a negative timeout, and takes an int of ms
+    double grace_s = result["grace"].as<double>();
+    if (grace_s < 0) {
+        std::cerr << "--grace must not be negative" << std::endl;
+        return 1;
+    }
+    int grace_ms = static_cast<int>(std::min(grace_s * 1000, static_cast<double>(INT_MAX)));
+
+    ContainerState state;
+    if (!load_state(result["id"].as<std::string>(), state)) {
+        return 1;
+    }
+    // Signalled through a pidfd, so a recycled pid is never hit
+    int pidfd = syscall(SYS_pidfd_open, state.pid, 0);
+    if (pidfd == -1 || syscall(SYS_pidfd_send_signal, pidfd, SIGTERM, nullptr, 0) == -1) {
+        std::cerr << "Container " << state.pid << " is not running — " << strerror(errno) << std::endl;
+        if (pidfd != -1) {
+            close(pidfd);
+        }
+        return 1;
+    }
+
+    // The pidfd becomes readable when the container's init exits; its
+    // supervisor then cleans up as usual
+    pollfd exited{pidfd, POLLIN, 0};
+    int ready;
+    while ((ready = poll(&exited, 1, grace_ms)) == -1 && errno == EINTR) {
+    }
+    close(pidfd);
+    if (ready == 0) {
+        std::cout << "Container " << state.pid << " did not exit within the grace period, killing it" << std::endl;
+        kill_cgroup(state.cgroup);
+    }
+    std::cout << "Stopped container " << state.pid << std::endl;
+    return 0;
+}
 
-    // Free the allocated stack
-    free(stack);
+// dockher gc
+// Cleans up containers and cgroups left behind by supervisors that were killed
+int gc_containers() {
+    int collected = collect_garbage();
+    std::cout << "Cleaned up " << collected << " container(s)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // The first argument may name a subcommand; anything else is a run, so
+    // "dockher --cmd ..." keeps working
+    std::string subcommand = argc > 1 ? argv[1] : "";
+    try {
+        if (subcommand == "update") {
+            return update_container(argc - 1, argv + 1);
+        }
+        if (subcommand == "stop") {
+            return stop_container(argc - 1, argv + 1);
+        }
+        if (subcommand == "exec") {
+            return exec_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "pipe") {
+            return pipe_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "pod") {
+            return pod_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "batch") {
+            return batch_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "tenant") {
+            return tenant_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "netns-pool") {
+            return netns_pool_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "gc") {
+            return gc_containers();
+        }
+        if (subcommand == "bench") {
+            return bench_main(argc - 1, argv + 1);
+        }
+        if (subcommand == "run") {
+            return run_container(argc - 1, argv + 1);
+        }
+        return run_container(argc, argv);
     } 
     /*
               All exceptions derive from "cxxopts::exceptions::exception"
@@ -143,6 +724,4 @@ int main(int argc, char *argv[]) {
         std::cerr << "Error defining options: " << e.what() << std::endl;
         return 1;
     }
-
-    return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,446 @@
+#include "net.hpp"
+
+#include <iostream>
+#include <functional>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <csignal>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <linux/ethtool.h>
+#include <linux/if_link.h>
+#include <linux/rtnetlink.h>
+#include <linux/sockios.h>
+#include <linux/veth.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+bool bring_up_loopback() {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    ifreq request;
+    memset(&request, 0, sizeof(request));
+    strncpy(request.ifr_name, "lo", IFNAMSIZ - 1);
+    bool ok = ioctl(fd, SIOCGIFFLAGS, &request) == 0;
+    if (ok && !(request.ifr_flags & IFF_UP)) {
+        request.ifr_flags |= IFF_UP | IFF_RUNNING;
+        ok = ioctl(fd, SIOCSIFFLAGS, &request) == 0;
+    }
+    close(fd);
+    return ok;
+}
+
+// A route netlink request built in place: header, fixed payload, then attributes
+class NetlinkRequest {
+public:
+    NetlinkRequest(uint16_t type, uint16_t flags) {
+        memset(buffer_, 0, sizeof(buffer_));
+        header()->nlmsg_len = NLMSG_LENGTH(0);
+        header()->nlmsg_type = type;
+        header()->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    }
+
+    nlmsghdr *header() { return reinterpret_cast<nlmsghdr *>(buffer_); }
+
+    // Appends the fixed part of the message (ifinfomsg, ifaddrmsg, ...)
+    template <typename T>
+    T *payload() {
+        T *data = reinterpret_cast<T *>(tail());
+        header()->nlmsg_len = NLMSG_ALIGN(header()->nlmsg_len) + sizeof(T);
+        return data;
+    }
+
+    rtattr *attr(uint16_t type, const void *data, size_t len) {
+        rtattr *a = reinterpret_cast<rtattr *>(tail());
+        a->rta_type = type;
+        a->rta_len = RTA_LENGTH(len);
+        if (len) {
+            memcpy(RTA_DATA(a), data, len);
+        }
+        header()->nlmsg_len = NLMSG_ALIGN(header()->nlmsg_len) + RTA_ALIGN(a->rta_len);
+        return a;
+    }
+    rtattr *attr(uint16_t type, const std::string &value) { return attr(type, value.c_str(), value.size() + 1); }
+    rtattr *attr(uint16_t type, uint32_t value) { return attr(type, &value, sizeof(value)); }
+
+    // Nested attributes: everything added until end() goes inside
+    rtattr *begin(uint16_t type) { return attr(type, nullptr, 0); }
+    void end(rtattr *nest) { nest->rta_len = tail() - reinterpret_cast<char *>(nest); }
+
+private:
+    char *tail() { return buffer_ + NLMSG_ALIGN(header()->nlmsg_len); }
+
+    char buffer_[1024];
+};
+
+// Sends the request and waits for the kernel's acknowledgement. Sets errno
+// and returns false if the kernel rejected it.
+static bool netlink_send(int fd, NetlinkRequest &request) {
+    if (send(fd, request.header(), request.header()->nlmsg_len, 0) == -1) {
+        return false;
+    }
+    char reply[4096];
+    ssize_t n = recv(fd, reply, sizeof(reply), 0);
+    if (n == -1) {
+        return false;
+    }
+    nlmsghdr *header = reinterpret_cast<nlmsghdr *>(reply);
+    if (NLMSG_OK(header, static_cast<size_t>(n)) && header->nlmsg_type == NLMSG_ERROR) {
+        nlmsgerr *error = static_cast<nlmsgerr *>(NLMSG_DATA(header));
+        if (error->error) {
+            errno = -error->error;
+            return false;
+        }
+    }
+    return true;
+}
+
+static int netlink_open() {
+    return socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+}
+
+// Sets an interface up, and its MTU and bridge if given
+static bool link_set(int fd, int index, int mtu, int master) {
+    NetlinkRequest request(RTM_NEWLINK, 0);
+    ifinfomsg *info = request.payload<ifinfomsg>();
+    info->ifi_family = AF_UNSPEC;
+    info->ifi_index = index;
+    info->ifi_flags = IFF_UP;
+    info->ifi_change = IFF_UP;
+    if (mtu > 0) {
+        request.attr(IFLA_MTU, static_cast<uint32_t>(mtu));
+    }
+    if (master > 0) {
+        request.attr(IFLA_MASTER, static_cast<uint32_t>(master));
+    }
+    return netlink_send(fd, request);
+}
+
+static bool link_delete(int fd, int index) {
+    NetlinkRequest request(RTM_DELLINK, 0);
+    ifinfomsg *info = request.payload<ifinfomsg>();
+    info->ifi_family = AF_UNSPEC;
+    info->ifi_index = index;
+    return netlink_send(fd, request);
+}
+
+// Adds address/prefix to an interface. An address that is already there is fine.
+static bool address_add(int fd, int index, const std::string &address, int prefix) {
+    NetlinkRequest request(RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL);
+    ifaddrmsg *info = request.payload<ifaddrmsg>();
+    info->ifa_family = AF_INET;
+    info->ifa_prefixlen = prefix;
+    info->ifa_index = index;
+    in_addr addr;
+    inet_pton(AF_INET, address.c_str(), &addr);
+    request.attr(IFA_LOCAL, &addr, sizeof(addr));
+    request.attr(IFA_ADDRESS, &addr, sizeof(addr));
+    return netlink_send(fd, request) || errno == EEXIST;
+}
+
+static bool default_route_add(int fd, const std::string &gateway) {
+    NetlinkRequest request(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL);
+    rtmsg *route = request.payload<rtmsg>();
+    route->rtm_family = AF_INET;
+    route->rtm_table = RT_TABLE_MAIN;
+    route->rtm_protocol = RTPROT_BOOT;
+    route->rtm_scope = RT_SCOPE_UNIVERSE;
+    route->rtm_type = RTN_UNICAST;
+    in_addr addr;
+    inet_pton(AF_INET, gateway.c_str(), &addr);
+    request.attr(RTA_GATEWAY, &addr, sizeof(addr));
+    return netlink_send(fd, request);
+}
+
+// An IPv4 subnet, with the network address in host byte order
+struct Subnet {
+    uint32_t network = 0;
+    int prefix = 0;
+
+    // The bridge's address: the first one after the network address
+    std::string gateway() const {
+        in_addr addr;
+        addr.s_addr = htonl(network + 1);
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr, text, sizeof(text));
+        return text;
+    }
+};
+
+// Between /8 and /30, so the address count fits an int and there is an
+// address left after the network, gateway and broadcast ones
+static bool parse_subnet(const std::string &text, Subnet &subnet) {
+    size_t slash = text.find('/');
+    in_addr addr;
+    if (slash == std::string::npos || inet_pton(AF_INET, text.substr(0, slash).c_str(), &addr) != 1) {
+        return false;
+    }
+    std::string prefix = text.substr(slash + 1);
+    char *end = nullptr;
+    long bits = strtol(prefix.c_str(), &end, 10);
+    if (prefix.empty() || *end != '\0' || bits < 8 || bits > 30) {
+        return false;
+    }
+    subnet.network = ntohl(addr.s_addr);
+    subnet.prefix = bits;
+    return (subnet.network & ((1u << (32 - bits)) - 1)) == 0;
+}
+
+bool validate_subnet(const std::string &subnet) {
+    Subnet parsed;
+    if (!parse_subnet(subnet, parsed)) {
+        std::cerr << "Invalid subnet \"" << subnet << "\": expected an IPv4 network between /8 and /30, e.g. "
+                  << NET_DEFAULT_SUBNET << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Creates the bridge with the gateway address, unless it already exists.
+// Supervisors using other subnets add their gateways to the same bridge.
+static bool ensure_bridge(int fd, int mtu, const Subnet &subnet) {
+    if (if_nametoindex(NET_BRIDGE) == 0) {
+        NetlinkRequest request(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+        request.payload<ifinfomsg>()->ifi_family = AF_UNSPEC;
+        request.attr(IFLA_IFNAME, std::string(NET_BRIDGE));
+        request.attr(IFLA_MTU, static_cast<uint32_t>(mtu));
+        rtattr *linkinfo = request.begin(IFLA_LINKINFO);
+        request.attr(IFLA_INFO_KIND, std::string("bridge"));
+        request.end(linkinfo);
+        // Another supervisor may have created it in the meantime
+        if (!netlink_send(fd, request) && errno != EEXIST) {
+            std::cerr << "Failed to create bridge " << NET_BRIDGE << " — " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    int index = if_nametoindex(NET_BRIDGE);
+    if (index == 0 || !address_add(fd, index, subnet.gateway(), subnet.prefix) || !link_set(fd, index, 0, 0)) {
+        std::cerr << "Failed to configure bridge " << NET_BRIDGE << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Creates a veth pair: host_name here, and "eth0" in the namespace netns_fd
+static bool veth_create(int fd, const std::string &host_name, int netns_fd, int mtu) {
+    NetlinkRequest request(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+    request.payload<ifinfomsg>()->ifi_family = AF_UNSPEC;
+    request.attr(IFLA_IFNAME, host_name);
+    request.attr(IFLA_MTU, static_cast<uint32_t>(mtu));
+    rtattr *linkinfo = request.begin(IFLA_LINKINFO);
+    request.attr(IFLA_INFO_KIND, std::string("veth"));
+    rtattr *data = request.begin(IFLA_INFO_DATA);
+    rtattr *peer = request.begin(VETH_INFO_PEER);
+    request.payload<ifinfomsg>()->ifi_family = AF_UNSPEC;
+    request.attr(IFLA_IFNAME, std::string("eth0"));
+    request.attr(IFLA_MTU, static_cast<uint32_t>(mtu));
+    request.attr(IFLA_NET_NS_FD, static_cast<uint32_t>(netns_fd));
+    request.end(peer);
+    request.end(data);
+    request.end(linkinfo);
+    return netlink_send(fd, request);
+}
+
+// Turns GRO and GSO on or off through the legacy ethtool ioctls
+static bool set_offloads(const std::string &ifname, const NetConfig &config) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = true;
+    for (auto setting : {std::make_pair(ETHTOOL_SGRO, config.gro), std::make_pair(ETHTOOL_SGSO, config.gso)}) {
+        ethtool_value value{static_cast<uint32_t>(setting.first), setting.second ? 1u : 0u};
+        ifreq request;
+        memset(&request, 0, sizeof(request));
+        strncpy(request.ifr_name, ifname.c_str(), IFNAMSIZ - 1);
+        request.ifr_data = reinterpret_cast<char *>(&value);
+        ok = ioctl(fd, SIOCETHTOOL, &request) == 0 && ok;
+    }
+    close(fd);
+    return ok;
+}
+
+// Runs f with this thread in the network namespace netns_fd, so the sockets
+// it opens (and their requests) belong to that namespace
+static bool in_netns(int netns_fd, const std::function<bool()> &f) {
+    int host_fd = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (host_fd == -1 || setns(netns_fd, CLONE_NEWNET) == -1) {
+        if (host_fd != -1) {
+            close(host_fd);
+        }
+        return false;
+    }
+    bool ok = f();
+    int error = errno;
+    if (setns(host_fd, CLONE_NEWNET) == -1) {
+        std::cerr << "Failed to return to the host network namespace — " << strerror(errno) << std::endl;
+        abort();
+    }
+    close(host_fd);
+    errno = error;
+    return ok;
+}
+
+// Takes the first free address after the gateway by linking a file with
+// our pid into IPAM_DIR under its name, starting from a point derived from
+// the pid to avoid contention. link() fails if the name exists, like O_EXCL,
+// but the file appears with its owner already written, so gc never sees
+// an empty one.
+static bool allocate_address(pid_t pid, const Subnet &subnet, std::string &address) {
+    mkdir(STATE_DIR, 0755);
+    mkdir(IPAM_DIR, 0755);
+    // Hidden, so gc passes over it
+    std::string tmp_path = std::string(IPAM_DIR) + "/.tmp." + std::to_string(pid);
+    std::string owner = std::to_string(pid) + "\n";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1 || write(fd, owner.c_str(), owner.size()) != static_cast<ssize_t>(owner.size())) {
+        std::cerr << "Failed to write: " << tmp_path << " — " << strerror(errno) << std::endl;
+        if (fd != -1) {
+            close(fd);
+            unlink(tmp_path.c_str());
+        }
+        return false;
+    }
+    close(fd);
+
+    const int hosts = (1 << (32 - subnet.prefix)) - 3;  // Minus network, gateway and broadcast
+    uint32_t base = subnet.network + 1;
+    bool allocated = false, failed = false;
+    for (int i = 0; i < hosts && !allocated && !failed; i++) {
+        in_addr addr;
+        addr.s_addr = htonl(base + 1 + (pid + i) % hosts);
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr, text, sizeof(text));
+        std::string path = std::string(IPAM_DIR) + "/" + text;
+        if (link(tmp_path.c_str(), path.c_str()) == 0) {
+            address = text;
+            allocated = true;
+        } else if (errno != EEXIST) {
+            std::cerr << "Failed to create: " << path << " — " << strerror(errno) << std::endl;
+            failed = true;
+        }
+    }
+    unlink(tmp_path.c_str());
+    if (!allocated && !failed) {
+        std::cerr << "No free address left in " << subnet.gateway() << "/" << subnet.prefix << std::endl;
+    }
+    return allocated;
+}
+
+bool attach_network(pid_t pid, int netns_fd, const NetConfig &config, NetEndpoint &endpoint) {
+    int fd = netlink_open();
+    if (fd == -1) {
+        std::cerr << "Failed to open netlink socket — " << strerror(errno) << std::endl;
+        return false;
+    }
+    Subnet subnet;
+    if (!parse_subnet(config.subnet, subnet)) {
+        validate_subnet(config.subnet);
+        close(fd);
+        return false;
+    }
+    if (!ensure_bridge(fd, config.mtu, subnet) || !allocate_address(pid, subnet, endpoint.address)) {
+        close(fd);
+        endpoint.address.clear();
+        return false;
+    }
+
+    endpoint.host_ifname = "dkh" + std::to_string(pid);
+    bool ok = veth_create(fd, endpoint.host_ifname, netns_fd, config.mtu);
+    if (!ok) {
+        std::cerr << "Failed to create veth pair " << endpoint.host_ifname << " — " << strerror(errno) << std::endl;
+        endpoint.host_ifname.clear();
+    } else if (!link_set(fd, if_nametoindex(endpoint.host_ifname.c_str()), 0, if_nametoindex(NET_BRIDGE))) {
+        std::cerr << "Failed to attach " << endpoint.host_ifname << " to " << NET_BRIDGE << " — " << strerror(errno) << std::endl;
+        ok = false;
+    }
+    close(fd);
+    // Offloads are a tuning knob; a driver that does not support them still works
+    if (ok) {
+        set_offloads(endpoint.host_ifname, config);
+    }
+
+    // The container's end is configured from inside its namespace
+    ok = ok && in_netns(netns_fd, [&]() {
+        int inner = netlink_open();
+        int index = if_nametoindex("eth0");
+        bool done = inner != -1 && index != 0 && bring_up_loopback() &&
+                    address_add(inner, index, endpoint.address, subnet.prefix) && link_set(inner, index, 0, 0) &&
+                    default_route_add(inner, subnet.gateway());
+        if (done) {
+            set_offloads("eth0", config);
+        }
+        if (inner != -1) {
+            close(inner);
+        }
+        return done;
+    });
+    if (!ok) {
+        if (!endpoint.host_ifname.empty()) {
+            std::cerr << "Failed to configure eth0 of container " << pid << " — " << strerror(errno) << std::endl;
+        }
+        detach_network(endpoint);
+        return false;
+    }
+    return true;
+}
+
+void detach_network(NetEndpoint &endpoint) {
+    // Deleting either end of a veth pair deletes both
+    if (!endpoint.host_ifname.empty()) {
+        int index = if_nametoindex(endpoint.host_ifname.c_str());
+        int fd = netlink_open();
+        if (fd != -1 && index != 0) {
+            link_delete(fd, index);
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+        endpoint.host_ifname.clear();
+    }
+    if (!endpoint.address.empty()) {
+        unlink((std::string(IPAM_DIR) + "/" + endpoint.address).c_str());
+        endpoint.address.clear();
+    }
+}
+
+int collect_network() {
+    int collected = 0;
+    DIR *dir = opendir(IPAM_DIR);
+    if (!dir) {
+        return 0;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] == '.') {
+            continue;
+        }
+        // Each address file names the container that holds it
+        std::string path = std::string(IPAM_DIR) + "/" + name;
+        FILE *file = fopen(path.c_str(), "r");
+        pid_t pid = -1;
+        if (!file || fscanf(file, "%d", &pid) != 1) {
+            pid = -1;
+        }
+        if (file) {
+            fclose(file);
+        }
+        if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) {
+            continue;
+        }
+        NetEndpoint endpoint{pid > 0 ? "dkh" + std::to_string(pid) : "", name};
+        std::cout << "Releasing address " << name << std::endl;
+        detach_network(endpoint);
+        collected++;
+    }
+    closedir(dir);
+    return collected;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include "state.hpp"
+
+// Local bridge network: containers get a veth pair whose host end is a port
+// of the bridge and whose other end is eth0 in the container, with an
+// address from the subnet. The bridge takes the subnet's first address as
+// gateway. Traffic between containers never leaves the host.
+#define NET_BRIDGE "dockher0"
+
+// Subnet used unless --subnet says otherwise. Podman defaults to the same
+// one, so hosts running both need to move one of them.
+#define NET_DEFAULT_SUBNET "10.88.0.0/16"
+
+// One address file per container address in use, holding the pid of its owner
+#define IPAM_DIR STATE_DIR "/ipam"
+
+// Defaults to an MTU about as large as veth allows, since the traffic never
+// hits a real wire: with 1500 bytes, per-packet costs halve the throughput
+#define NET_DEFAULT_MTU 65520
+
+struct NetConfig {
+    std::string subnet = NET_DEFAULT_SUBNET;  // IPv4 subnet in CIDR notation
+    int mtu = NET_DEFAULT_MTU;
+    bool gro = true;   // Generic receive offload on both veth ends
+    bool gso = true;   // Generic segmentation offload on both veth ends
+};
+
+// A container's attachment to the bridge
+struct NetEndpoint {
+    std::string host_ifname;  // Host end of the veth pair, "dkh<pid>"
+    std::string address;      // Container address, e.g. "10.88.0.2"
+};
+
+// Checks that subnet is an IPv4 network in CIDR notation (host bits zero)
+// with room for the gateway and at least one container
+bool validate_subnet(const std::string &subnet);
+
+// Brings up the loopback interface of the calling process's network
+// namespace. Uses only system calls, so it is safe in a cloned child.
+bool bring_up_loopback();
+
+// Creates the bridge if needed, then connects the network namespace netns_fd
+// (a container's, before it starts) to it with a veth pair: eth0 inside,
+// with an allocated address and a default route via the bridge. Everything
+// created is removed again on failure.
+bool attach_network(pid_t pid, int netns_fd, const NetConfig &config, NetEndpoint &endpoint);
+
+// Deletes the veth pair and releases the container's address
+void detach_network(NetEndpoint &endpoint);
+
+// Releases addresses and veth pairs of containers that are gone. Returns how many.
+int collect_network();
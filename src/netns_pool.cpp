@@ -0,0 +1,227 @@
+#include "netns_pool.hpp"
+#include "cgroup.hpp"
+#include "net.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/file.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+
+// Pool size of the last fill, which refills go back up to
+#define NETNS_POOL_SIZE_FILE NETNS_POOL_DIR "/.size"
+
+// Held while filling or draining, so concurrent fills do not overshoot
+#define NETNS_POOL_LOCK NETNS_POOL_DIR "/.lock"
+
+// Names of the namespaces in the pool. Dot files are ours, and
+// "<name>.claim" marks a namespace being taken out.
+static std::vector<std::string> pool_entries() {
+    std::vector<std::string> names;
+    DIR *dir = opendir(NETNS_POOL_DIR);
+    if (!dir) {
+        return names;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.empty() || name[0] == '.' ||
+            (name.size() > 6 && name.compare(name.size() - 6, 6, ".claim") == 0)) {
+            continue;
+        }
+        names.push_back(name);
+    }
+    closedir(dir);
+    return names;
+}
+
+static int lock_pool() {
+    mkdir(STATE_DIR, 0755);
+    mkdir(NETNS_POOL_DIR, 0755);
+    int fd = open(NETNS_POOL_LOCK, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1 || flock(fd, LOCK_EX) == -1) {
+        std::cerr << "Failed to lock: " << NETNS_POOL_LOCK << " — " << strerror(errno) << std::endl;
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Unmounts and removes one pool entry
+static void remove_entry(const std::string &path) {
+    umount2(path.c_str(), MNT_DETACH);
+    unlink(path.c_str());
+}
+
+int fill_netns_pool(int size) {
+    int lock_fd = lock_pool();
+    if (lock_fd == -1) {
+        return -1;
+    }
+    write_to_file(NETNS_POOL_SIZE_FILE, std::to_string(size));
+
+    int host_fd = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (host_fd == -1) {
+        std::cerr << "Failed to open our network namespace — " << strerror(errno) << std::endl;
+        close(lock_fd);
+        return -1;
+    }
+
+    // Each namespace is created by moving ourselves into a fresh one, which
+    // the bind mount then keeps alive after we move back
+    int missing = size - static_cast<int>(pool_entries().size());
+    int created = 0;
+    for (int i = 0; i < missing; i++) {
+        std::string path = std::string(NETNS_POOL_DIR) + "/ns_" + std::to_string(getpid()) + "_" + std::to_string(i);
+        int fd = open(path.c_str(), O_RDONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+        if (fd == -1) {
+            std::cerr << "Failed to create: " << path << " — " << strerror(errno) << std::endl;
+            break;
+        }
+        close(fd);
+        bool ok = unshare(CLONE_NEWNET) == 0 && bring_up_loopback() &&
+                  mount("/proc/self/ns/net", path.c_str(), NULL, MS_BIND, NULL) == 0;
+        int error = errno;
+        if (setns(host_fd, CLONE_NEWNET) == -1) {
+            std::cerr << "Failed to return to the host network namespace — " << strerror(errno) << std::endl;
+            _exit(1);
+        }
+        if (!ok) {
+            std::cerr << "Failed to create network namespace: " << path << " — " << strerror(error) << std::endl;
+            remove_entry(path);
+            break;
+        }
+        created++;
+    }
+    close(host_fd);
+    close(lock_fd);
+    return created;
+}
+
+int claim_netns() {
+    for (const std::string &name : pool_entries()) {
+        // Whoever creates the claim file first gets the namespace
+        std::string path = std::string(NETNS_POOL_DIR) + "/" + name;
+        std::string claim = path + ".claim";
+        int claim_fd = open(claim.c_str(), O_RDONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+        if (claim_fd == -1) {
+            continue;
+        }
+        close(claim_fd);
+
+        // An entry still being filled is a plain empty file, not a namespace
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct statfs fs;
+        if (fd != -1 && (fstatfs(fd, &fs) == -1 || fs.f_type != NSFS_MAGIC)) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd != -1) {
+            remove_entry(path);
+        }
+        unlink(claim.c_str());
+        if (fd != -1) {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+void refill_netns_pool() {
+    std::string size;
+    if (!read_file(NETNS_POOL_SIZE_FILE, size) || size.empty()) {
+        return;
+    }
+    // Double fork, so the filler is neither our child to reap nor killed
+    // along with us
+    pid_t pid = fork();
+    if (pid == 0) {
+        setsid();
+        if (fork() != 0) {
+            _exit(0);
+        }
+        int null_fd = open("/dev/null", O_RDWR);
+        for (int fd : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}) {
+            dup2(null_fd, fd);
+        }
+        execl("/proc/self/exe", "dockher", "netns-pool", "fill", "--size", size.c_str(), (char *)NULL);
+        _exit(1);
+    }
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+// Removes every namespace from the pool and stops refills
+static int drain_netns_pool() {
+    int lock_fd = lock_pool();
+    if (lock_fd == -1) {
+        return -1;
+    }
+    int removed = 0;
+    for (const std::string &name : pool_entries()) {
+        remove_entry(std::string(NETNS_POOL_DIR) + "/" + name);
+        removed++;
+    }
+    unlink(NETNS_POOL_SIZE_FILE);
+    close(lock_fd);
+    return removed;
+}
+
+int netns_pool_main(int argc, char *argv[]) {
+    cxxopts::Options options("dockher netns-pool", "Manage the pool of pre-created network namespaces");
+    options.add_options()
+        ("action", "fill, status or drain", cxxopts::value<std::string>())
+        ("n,size", "Namespaces to keep in the pool (fill)", cxxopts::value<int>()->default_value("8"))
+        ("h,help", "Print usage");
+    options.parse_positional({"action"});
+    options.positional_help("fill|status|drain");
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("action")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+
+    std::string action = result["action"].as<std::string>();
+    if (action == "fill") {
+        int size = result["size"].as<int>();
+        if (size < 0) {
+            std::cerr << "--size must not be negative" << std::endl;
+            return 1;
+        }
+        int created = fill_netns_pool(size);
+        if (created == -1) {
+            return 1;
+        }
+        std::cout << "Created " << created << " network namespace(s), " << pool_entries().size() << " in the pool" << std::endl;
+        return 0;
+    }
+    if (action == "status") {
+        std::string size;
+        read_file(NETNS_POOL_SIZE_FILE, size);
+        std::cout << "Pool: " << pool_entries().size() << " of " << (size.empty() ? "0" : size) << std::endl;
+        return 0;
+    }
+    if (action == "drain") {
+        int removed = drain_netns_pool();
+        if (removed == -1) {
+            return 1;
+        }
+        std::cout << "Removed " << removed << " network namespace(s)" << std::endl;
+        return 0;
+    }
+    std::cerr << "Unknown action: " << action << " (available: fill, status, drain)" << std::endl;
+    return 1;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "state.hpp"
+
+// Pre-created network namespaces, each kept alive by a bind mount of its
+// nsfs file at NETNS_POOL_DIR/<name>
+#define NETNS_POOL_DIR STATE_DIR "/netns"
+
+// Tops the pool up to size namespaces, each with its loopback already up.
+// Returns how many were created, or -1 on error.
+int fill_netns_pool(int size);
+
+// Takes a namespace out of the pool and returns a descriptor for setns(),
+// or -1 if the pool is empty. The namespace is no longer in the pool; it
+// lives as long as the descriptor or a process inside it.
+int claim_netns();
+
+// Starts a detached "dockher netns-pool fill" back up to the size of the
+// last fill, without waiting for it. Does nothing if no pool was set up.
+void refill_netns_pool();
+
+// dockher netns-pool fill --size N | status | drain
+int netns_pool_main(int argc, char *argv[]);
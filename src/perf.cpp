@@ -0,0 +1,172 @@
+#include "perf.hpp"
+#include "cgroup.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const char *const event_names[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "cache_misses", "context_switches", "page_faults"
+};
+
+static void event_attr(PerfEvent event, perf_event_attr &attr) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (event) {
+    case PERF_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PERF_INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PERF_CACHE_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PERF_CONTEXT_SWITCHES:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+        break;
+    case PERF_PAGE_FAULTS:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+        break;
+    default:
+        break;
+    }
+    // Needed to scale counts when more events are open than hardware counters
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> online_cpus() {
+    std::string list;
+    if (!read_file("/sys/devices/system/cpu/online", list)) {
+        return {0};
+    }
+    return parse_cpu_list(list);
+}
+
+double PerfTotals::ipc() const {
+    if (!available[PERF_CYCLES] || !available[PERF_INSTRUCTIONS] || values[PERF_CYCLES] == 0) {
+        return 0;
+    }
+    return static_cast<double>(values[PERF_INSTRUCTIONS]) / values[PERF_CYCLES];
+}
+
+bool PerfCounters::open(const std::string &cgroup_path) {
+    // Cgroup mode takes the cgroup directory fd in place of a pid
+    int cgroup_fd = ::open(cgroup_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroup_fd == -1) {
+        std::cerr << "Failed to open cgroup: " << cgroup_path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Cgroup events only exist per CPU, so open one of each on every CPU
+    std::vector<int> cpus = online_cpus();
+    bool any = false;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        perf_event_attr attr;
+        event_attr(static_cast<PerfEvent>(event), attr);
+        for (int cpu : cpus) {
+            int fd = syscall(SYS_perf_event_open, &attr, cgroup_fd, cpu, -1, PERF_FLAG_PID_CGROUP | PERF_FLAG_FD_CLOEXEC);
+            if (fd == -1) {
+                // Typically a hardware event missing in a VM; skip just this event
+                std::cerr << "Perf counter " << event_names[event] << " unavailable: " << strerror(errno) << std::endl;
+                for (int open_fd : fds_[event]) {
+                    ::close(open_fd);
+                }
+                fds_[event].clear();
+                break;
+            }
+            fds_[event].push_back(fd);
+        }
+        any = any || !fds_[event].empty();
+    }
+    ::close(cgroup_fd);
+    return any;
+}
+
+PerfTotals PerfCounters::read() const {
+    PerfTotals totals;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        if (fds_[event].empty()) {
+            continue;
+        }
+        totals.available[event] = true;
+        for (int fd : fds_[event]) {
+            // value, time_enabled, time_running
+            uint64_t data[3];
+            if (::read(fd, data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+                continue;
+            }
+            totals.values[event] += data[2] < data[1]
+                ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2])
+                : data[0];
+        }
+    }
+    return totals;
+}
+
+void PerfCounters::close() {
+    for (auto &fds : fds_) {
+        for (int fd : fds) {
+            ::close(fd);
+        }
+        fds.clear();
+    }
+}
+
+void print_perf_totals(const PerfTotals &totals) {
+    std::cout << "Perf counters:\n";
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        std::cout << "  " << event_names[event] << ": ";
+        if (totals.available[event]) {
+            std::cout << totals.values[event] << std::endl;
+        } else {
+            std::cout << "n/a" << std::endl;
+        }
+    }
+    if (totals.ipc() > 0) {
+        std::cout << "  ipc: " << std::fixed << std::setprecision(2) << totals.ipc() << std::defaultfloat << std::endl;
+    }
+}
+
+std::string format_perf_totals(const PerfTotals &totals) {
+    std::ostringstream out;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        if (totals.available[event]) {
+            out << " " << event_names[event] << "=" << totals.values[event];
+        }
+    }
+    if (totals.ipc() > 0) {
+        out << " ipc=" << std::fixed << std::setprecision(2) << totals.ipc();
+    }
+    return out.str();
+}
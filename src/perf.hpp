@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hardware and software counters collected for a whole cgroup
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_PAGE_FAULTS,
+    PERF_EVENT_COUNT
+};
+
+// Summed counter values. Events the CPU or kernel does not support are
+// marked unavailable instead of failing the whole set.
+struct PerfTotals {
+    uint64_t values[PERF_EVENT_COUNT] = {};
+    bool available[PERF_EVENT_COUNT] = {};
+
+    // Instructions per cycle, or 0 if either counter is unavailable
+    double ipc() const;
+};
+
+// Counts events for every task in a cgroup, using perf_event_open in cgroup
+// mode: one counter per event per online CPU, summed on read
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters() { close(); }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Opens and enables the counters on the cgroup directory. Returns false
+    // if no event could be opened at all.
+    bool open(const std::string &cgroup_path);
+
+    // Current totals, scaled up for time the counters were multiplexed out
+    PerfTotals read() const;
+
+    void close();
+
+private:
+    // fds_[event] holds one descriptor per online CPU, empty if unsupported
+    std::vector<int> fds_[PERF_EVENT_COUNT];
+};
+
+// Prints totals and IPC in the same "name: value" layout as the run summary
+void print_perf_totals(const PerfTotals &totals);
+
+// Formats totals as space separated key=value pairs for the stats stream
+std::string format_perf_totals(const PerfTotals &totals);
+
+// CPUs listed in /sys/devices/system/cpu/online
+std::vector<int> online_cpus();
+
+// Expands a kernel cpu list such as "0-3,6" into CPU numbers
+std::vector<int> parse_cpu_list(const std::string &list);
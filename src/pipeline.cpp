@@ -0,0 +1,231 @@
+#include "pipeline.hpp"
+#include "container.hpp"
+#include "histogram.hpp"
+#include "log.hpp"
+#include "state.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+// Largest chunk moved by one splice call
+#define PIPE_CHUNK (1024 * 1024)
+
+// Where one stage's output goes, and how much of it has been moved
+struct PipeLink {
+    int from = -1;          // Read end of the stage's stdout pipe
+    int to = -1;            // Write end of the next stage's stdin pipe, or our stdout
+    uint64_t bytes = 0;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;    // When the stage's output hit EOF
+};
+
+// Moves everything from link.from to link.to. Pipe to pipe is a pure
+// splice; writing to a terminal needs a copy, since splice() cannot.
+static void pump(PipeLink &link) {
+    link.start_ns = monotonic_ns();
+    bool copy = false;
+    std::vector<char> buffer;
+    for (;;) {
+        ssize_t n;
+        if (!copy) {
+            n = splice(link.from, nullptr, link.to, nullptr, PIPE_CHUNK, SPLICE_F_MOVE);
+            if (n == -1 && errno == EINVAL) {
+                copy = true;
+                buffer.resize(64 * 1024);
+                continue;
+            }
+        } else {
+            n = read(link.from, buffer.data(), buffer.size());
+            for (ssize_t done = 0; n > 0 && done < n;) {
+                ssize_t w = write(link.to, buffer.data() + done, n - done);
+                if (w <= 0) {
+                    n = -1;
+                    break;
+                }
+                done += w;
+            }
+        }
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // EOF, or the next stage exited (EPIPE): close both ends so the
+            // neighbours see EOF and SIGPIPE just as in a shell pipeline
+            break;
+        }
+        link.bytes += n;
+    }
+    link.end_ns = monotonic_ns();
+    close(link.from);
+    if (link.to != STDOUT_FILENO) {
+        close(link.to);
+    }
+}
+
+static std::string describe_status(int status) {
+    if (status == -1) {
+        return "error";
+    }
+    if (WIFSIGNALED(status)) {
+        return std::string("signal ") + strsignal(WTERMSIG(status));
+    }
+    return "exit " + std::to_string(WEXITSTATUS(status));
+}
+
+int pipe_main(int argc, char *argv[]) {
+    cxxopts::Options options("dockher pipe", "Run containers as a pipeline, stdout of each feeding the next");
+    options.add_options()
+        ("stage", "Stage as [mem=MB,cpu=%,...:]command; repeat for each stage in order", cxxopts::value<std::string>())
+        ("rootfs", "Root filesystem of the containers", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("stage")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+
+    // Collected from the raw arguments: a vector option would split the
+    // specs on the commas between their limits
+    std::vector<std::string> specs;
+    for (const cxxopts::KeyValue &argument : result.arguments()) {
+        if (argument.key() == "stage") {
+            specs.push_back(argument.value());
+        }
+    }
+    size_t count = specs.size();
+    // Containers keep a pointer to their config, so the vector must not reallocate
+    std::vector<ContainerConfig> configs(count);
+    for (size_t i = 0; i < count; i++) {
+        configs[i].rootfs = result["rootfs"].as<std::string>();
+        if (!parse_container_spec(specs[i], configs[i])) {
+            return 1;
+        }
+    }
+
+    // A stage exiting early must not kill us through a pump's write
+    signal(SIGPIPE, SIG_IGN);
+
+    // Stage i writes into out[i]; its pump splices that into in[i + 1],
+    // which stage i + 1 reads as stdin. The first stage reads our stdin.
+    std::vector<PipeLink> links(count);
+    std::vector<Container> containers(count);
+    int next_stdin = -1;
+    bool ok = true;
+    size_t created = 0;
+    for (size_t i = 0; i < count && ok; i++) {
+        int out[2];
+        if (!create_log_pipe(out)) {
+            ok = false;
+            break;
+        }
+        // The pumps block in splice(), so the read end goes back to blocking
+        fcntl(out[0], F_SETFL, fcntl(out[0], F_GETFL) & ~O_NONBLOCK);
+        configs[i].stdin_fd = next_stdin;
+        configs[i].stdout_fd = out[1];
+        links[i].from = out[0];
+
+        ok = create_container(configs[i], containers[i]);
+        close(out[1]);
+        if (next_stdin != -1) {
+            close(next_stdin);
+            next_stdin = -1;
+        }
+        if (!ok) {
+            break;
+        }
+        created++;
+
+        if (i + 1 < count) {
+            int in[2];
+            if (!create_log_pipe(in)) {
+                ok = false;
+                break;
+            }
+            fcntl(in[0], F_SETFL, fcntl(in[0], F_GETFL) & ~O_NONBLOCK);
+            links[i].to = in[1];
+            next_stdin = in[0];
+        } else {
+            links[i].to = STDOUT_FILENO;
+        }
+    }
+    if (!ok) {
+        for (size_t i = 0; i < count; i++) {
+            for (int fd : {links[i].from, links[i].to}) {
+                if (fd != -1 && fd != STDOUT_FILENO) {
+                    close(fd);
+                }
+            }
+        }
+        for (size_t i = 0; i < created; i++) {
+            destroy_container(containers[i]);
+        }
+        return 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ContainerState state;
+        state.pid = containers[i].pid;
+        state.supervisor = getpid();
+        state.cgroup = containers[i].cgroup;
+        state.rootfs = configs[i].rootfs;
+        state.cmd = configs[i].cmd;
+        save_state(state);
+        std::cerr << "Stage " << i << ": container " << containers[i].pid << " \"" << configs[i].cmd << "\"" << std::endl;
+    }
+
+    // Start every stage, then the pumps between them
+    uint64_t start = monotonic_ns();
+    std::vector<std::thread> pumps;
+    for (size_t i = 0; i < count; i++) {
+        if (!start_container(containers[i])) {
+            ok = false;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        pumps.emplace_back(pump, std::ref(links[i]));
+    }
+
+    std::vector<int> statuses(count);
+    for (size_t i = 0; i < count; i++) {
+        statuses[i] = wait_container(containers[i]);
+    }
+    for (std::thread &pump_thread : pumps) {
+        pump_thread.join();
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+
+    // Per-stage throughput goes to stderr, since stdout carries the data
+    std::cerr << std::left << std::setw(7) << "stage" << std::setw(30) << "command" << std::right
+              << std::setw(14) << "bytes out" << std::setw(12) << "MB/s" << std::setw(12) << "runtime"
+              << "  status" << std::endl;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t runtime = containers[i].exited_ns - containers[i].exec_ns;
+        uint64_t active = links[i].end_ns - links[i].start_ns;
+        std::cerr << std::left << std::setw(7) << i << std::setw(30) << configs[i].cmd.substr(0, 28) << std::right
+                  << std::setw(14) << links[i].bytes
+                  << std::setw(12) << std::fixed << std::setprecision(1)
+                  << (active ? links[i].bytes / (active / 1e9) / (1024 * 1024) : 0.0)
+                  << std::setw(12) << format_ns(runtime)
+                  << "  " << describe_status(statuses[i]) << std::endl;
+        remove_state(containers[i].pid);
+        destroy_container(containers[i]);
+    }
+    std::cerr << "Pipeline: " << format_ns(elapsed) << std::endl;
+
+    // Like a shell, the pipeline's status is the last stage's
+    int last = statuses.back();
+    if (!ok || last == -1) {
+        return 1;
+    }
+    return WIFEXITED(last) ? WEXITSTATUS(last) : 128 + WTERMSIG(last);
+}
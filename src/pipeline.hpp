@@ -0,0 +1,6 @@
+#pragma once
+
+// dockher pipe --stage <spec> --stage <spec> ...
+// Runs containers as a pipeline, each stage's stdout feeding the next
+// stage's stdin, with the supervisor moving the data between them
+int pipe_main(int argc, char *argv[]);
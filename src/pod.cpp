@@ -0,0 +1,199 @@
+#include "pod.hpp"
+#include "cgroup.hpp"
+#include "container.hpp"
+#include "histogram.hpp"
+#include "net.hpp"
+#include "state.hpp"
+#include "trace.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+// Namespaces every pod member shares with the infra container
+static const std::pair<int, const char *> pod_namespaces[] = {
+    {CLONE_NEWNET, "net"}, {CLONE_NEWIPC, "ipc"}, {CLONE_NEWUTS, "uts"},
+};
+
+static std::string describe_status(int status) {
+    if (status == -1) {
+        return "error";
+    }
+    if (WIFSIGNALED(status)) {
+        return std::string("signal ") + strsignal(WTERMSIG(status));
+    }
+    return "exit " + std::to_string(WEXITSTATUS(status));
+}
+
+int pod_main(int argc, char *argv[]) {
+    cxxopts::Options options("dockher pod", "Run containers as a pod sharing network, IPC and UTS namespaces");
+    options.add_options()
+        ("member", "Member as [mem=MB,cpu=%,...:]command; repeat for each member", cxxopts::value<std::string>())
+        ("m,mem", "Memory limit of the whole pod (MB)", cxxopts::value<long long>())
+        ("p,cpu", "CPU limit of the whole pod (%)", cxxopts::value<int>())
+        ("net", "Connect the pod to the local bridge network (bridge)", cxxopts::value<std::string>())
+        ("subnet", "Subnet of the bridge network", cxxopts::value<std::string>()->default_value(NET_DEFAULT_SUBNET))
+        ("rootfs", "Root filesystem of the members", cxxopts::value<std::string>()->default_value(DEFAULT_ROOTFS))
+        ("h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("member")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+
+    // Collected from the raw arguments, as a vector option would split the
+    // specs on the commas between their limits
+    std::vector<ContainerConfig> members;
+    for (const cxxopts::KeyValue &argument : result.arguments()) {
+        if (argument.key() == "member") {
+            members.emplace_back();
+            members.back().rootfs = result["rootfs"].as<std::string>();
+            if (!parse_container_spec(argument.value(), members.back())) {
+                return 1;
+            }
+        }
+    }
+    Limits pod_limits;
+    pod_limits.mem_mb = result.count("mem") ? result["mem"].as<long long>() : -1;
+    pod_limits.cpu_pct = result.count("cpu") ? result["cpu"].as<int>() : -1;
+    if (!validate_limits(pod_limits)) {
+        return 1;
+    }
+    bool network = result.count("net") != 0;
+    if (network && result["net"].as<std::string>() != "bridge") {
+        std::cerr << "Network mode must be bridge" << std::endl;
+        return 1;
+    }
+    NetConfig net_config;
+    net_config.subnet = result["subnet"].as<std::string>();
+    if (network && !validate_subnet(net_config.subnet)) {
+        return 1;
+    }
+
+    // The pod's cgroup carries the aggregate limits. Processes may only sit
+    // in its leaves, so the infra container gets a child cgroup like the members.
+    std::string pod_cgroup = std::string(CGROUP_ROOT) + "/dockher_pod_" + std::to_string(getpid());
+    enable_controllers(CGROUP_ROOT);
+    if (!create_cgroup(pod_cgroup)) {
+        return 1;
+    }
+    if (!apply_limits(pod_cgroup, pod_limits)) {
+        remove_cgroup(pod_cgroup);
+        return 1;
+    }
+
+    // The infra container only holds the shared namespaces for the members
+    // to join, so they are created once per pod rather than per member
+    ContainerConfig infra_config;
+    infra_config.rootfs = result["rootfs"].as<std::string>();
+    infra_config.cgroup_parent = pod_cgroup;
+    infra_config.namespaces = DEFAULT_NAMESPACES | CLONE_NEWNET | CLONE_NEWIPC | CLONE_NEWUTS;
+    infra_config.workload = []() {
+        for (;;) {
+            pause();
+        }
+        return 0;
+    };
+    Container infra;
+    NetEndpoint endpoint;
+    std::vector<int> namespace_fds;
+    bool ok = create_container(infra_config, infra);
+    for (const auto &ns : pod_namespaces) {
+        if (!ok) {
+            break;
+        }
+        std::string path = "/proc/" + std::to_string(infra.pid) + "/ns/" + ns.second;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            std::cerr << "Failed to open: " << path << " — " << strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        namespace_fds.push_back(fd);
+        for (ContainerConfig &member : members) {
+            member.join_namespaces.emplace_back(ns.first, fd);
+        }
+    }
+    if (ok && network) {
+        ok = attach_network(infra.pid, namespace_fds[0], net_config, endpoint);
+    }
+    ok = ok && start_container(infra);
+
+    // Members join the infra's namespaces in cgroups of their own under the pod
+    std::vector<Container> containers(members.size());
+    size_t created = 0;
+    for (size_t i = 0; ok && i < members.size(); i++) {
+        members[i].cgroup_parent = pod_cgroup;
+        members[i].namespaces &= ~(CLONE_NEWNET | CLONE_NEWIPC | CLONE_NEWUTS);
+        ok = create_container(members[i], containers[i]);
+        created += ok;
+    }
+    for (int fd : namespace_fds) {
+        close(fd);
+    }
+
+    std::vector<int> statuses(members.size(), -1);
+    if (ok) {
+        std::cout << "Pod " << pod_cgroup << ": infra container " << infra.pid;
+        if (network) {
+            std::cout << ", IP address " << endpoint.address;
+        }
+        std::cout << std::endl;
+        for (size_t i = 0; i < members.size(); i++) {
+            ContainerState state;
+            state.pid = containers[i].pid;
+            state.supervisor = getpid();
+            state.cgroup = containers[i].cgroup;
+            state.rootfs = members[i].rootfs;
+            state.cmd = members[i].cmd;
+            save_state(state);
+            std::cout << "Member " << i << ": container " << containers[i].pid << " \"" << members[i].cmd << "\"" << std::endl;
+        }
+        for (size_t i = 0; i < members.size(); i++) {
+            if (!start_container(containers[i])) {
+                ok = false;
+            }
+        }
+        for (size_t i = 0; i < members.size(); i++) {
+            statuses[i] = wait_container(containers[i]);
+        }
+
+        std::cout << std::left << std::setw(8) << "member" << std::setw(30) << "command" << std::right
+                  << std::setw(12) << "runtime" << std::setw(12) << "cpu" << std::setw(14) << "memory.peak"
+                  << "  status" << std::endl;
+        for (size_t i = 0; i < members.size(); i++) {
+            long long peak = read_cgroup_value(containers[i].cgroup + "/memory.peak");
+            std::cout << std::left << std::setw(8) << i << std::setw(30) << members[i].cmd.substr(0, 28) << std::right
+                      << std::setw(12) << format_ns(containers[i].exited_ns - containers[i].exec_ns)
+                      << std::setw(12) << format_ns(read_cgroup_stat(containers[i].cgroup + "/cpu.stat", "usage_usec") * 1000)
+                      << std::setw(14) << (peak == -1 ? "-" : std::to_string(peak / 1024) + " KB")
+                      << "  " << describe_status(statuses[i]) << std::endl;
+            remove_state(containers[i].pid);
+        }
+        long long pod_peak = read_cgroup_value(pod_cgroup + "/memory.peak");
+        std::cout << "Pod memory.peak: " << (pod_peak == -1 ? "-" : std::to_string(pod_peak / 1024) + " KB") << std::endl;
+    }
+
+    for (size_t i = 0; i < created; i++) {
+        destroy_container(containers[i]);
+    }
+    destroy_container(infra);
+    detach_network(endpoint);
+    remove_cgroup(pod_cgroup);
+
+    if (!ok) {
+        return 1;
+    }
+    for (int status : statuses) {
+        if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
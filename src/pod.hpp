@@ -0,0 +1,6 @@
+#pragma once
+
+// dockher pod --member <spec> --member <spec> ... [--mem MB] [--cpu %]
+// Runs containers as a pod: they share network, IPC and UTS namespaces held
+// by an infra container, and sit under one cgroup with aggregate limits
+int pod_main(int argc, char *argv[]);
@@ -0,0 +1,105 @@
+#include "pressure.hpp"
+#include "cgroup.hpp"
+#include "trace.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+// First and longest wait between checks while launches are held
+#define PRESSURE_BACKOFF_MIN_MS 100
+#define PRESSURE_BACKOFF_MAX_MS 2000
+
+double read_pressure(const std::string &path) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        // some avg10=2.50 avg60=2.57 avg300=3.91 total=223461583
+        if (line.compare(0, 5, "some ") != 0) {
+            continue;
+        }
+        size_t pos = line.find("avg10=");
+        if (pos == std::string::npos) {
+            return -1;
+        }
+        const char *start = line.c_str() + pos + 6;
+        char *end = nullptr;
+        double value = strtod(start, &end);
+        return end == start ? -1 : value;
+    }
+    return -1;
+}
+
+PressureGate::PressureGate(const PressureThresholds &thresholds, const std::string &cgroup_parent)
+    : thresholds_(thresholds), cgroup_parent_(cgroup_parent) {
+    // The root cgroup's pressure files are the host's again
+    if (cgroup_parent_ == CGROUP_ROOT) {
+        cgroup_parent_.clear();
+    }
+}
+
+bool PressureGate::over(std::string &reason) {
+    const std::pair<const char *, double> resources[] = {
+        {"cpu", thresholds_.cpu}, {"memory", thresholds_.memory}, {"io", thresholds_.io},
+    };
+    for (const auto &resource : resources) {
+        if (resource.second < 0) {
+            continue;
+        }
+        std::string paths[] = {
+            std::string("/proc/pressure/") + resource.first,
+            cgroup_parent_.empty() ? "" : cgroup_parent_ + "/" + resource.first + ".pressure",
+        };
+        for (const std::string &path : paths) {
+            double avg10 = path.empty() ? -1 : read_pressure(path);
+            if (avg10 > resource.second) {
+                std::ostringstream out;
+                out << resource.first << " pressure " << avg10 << "% > " << resource.second << "% (" << path << ")";
+                reason = out.str();
+                worst_ = std::max(worst_, avg10);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+PressureGate::Decision PressureGate::check(std::string &reason) {
+    if (!thresholds_.enabled()) {
+        return ADMIT;
+    }
+    uint64_t now = monotonic_ns();
+    if (!over(reason)) {
+        if (stall_start_) {
+            held_ns_ += now - stall_start_;
+            stall_start_ = 0;
+        }
+        backoff_ms_ = 0;
+        return ADMIT;
+    }
+    if (!stall_start_) {
+        stall_start_ = now;
+        stalls_++;
+    }
+    if (static_cast<long>((now - stall_start_) / 1000000) >= thresholds_.timeout_ms) {
+        held_ns_ += now - stall_start_;
+        stall_start_ = 0;
+        backoff_ms_ = 0;
+        rejections_++;
+        return REJECT;
+    }
+    backoff_ms_ = backoff_ms_ ? std::min(backoff_ms_ * 2, static_cast<long>(PRESSURE_BACKOFF_MAX_MS)) : PRESSURE_BACKOFF_MIN_MS;
+    return DELAY;
+}
+
+bool PressureGate::wait(std::string &reason) {
+    for (;;) {
+        Decision decision = check(reason);
+        if (decision != DELAY) {
+            return decision == ADMIT;
+        }
+        usleep(backoff_ms_ * 1000);
+    }
+}
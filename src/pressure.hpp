@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Stall percentages ("some avg10" of PSI) above which new containers are
+// held back; -1 leaves that resource unchecked
+struct PressureThresholds {
+    double cpu = -1;
+    double memory = -1;
+    double io = -1;
+    long timeout_ms = 30000;   // How long a launch may be held before it is rejected
+
+    bool enabled() const { return cpu >= 0 || memory >= 0 || io >= 0; }
+};
+
+// Reads the "some avg10" stall percentage from a PSI file such as
+// /proc/pressure/memory or a cgroup's memory.pressure. Returns -1 if missing.
+double read_pressure(const std::string &path);
+
+// Decides whether a container may be launched now, from the pressure of
+// the host and of the cgroup it is created in. While either is over a
+// threshold launches are delayed, retrying with a growing backoff, and
+// rejected once they have been held for the timeout.
+class PressureGate {
+public:
+    enum Decision { ADMIT, DELAY, REJECT };
+
+    PressureGate(const PressureThresholds &thresholds, const std::string &cgroup_parent);
+
+    // Checks the pressure now. On DELAY or REJECT, reason names the
+    // resource and reading that held the launch back.
+    Decision check(std::string &reason);
+
+    // Milliseconds to wait before checking again after a DELAY
+    long backoff_ms() const { return backoff_ms_; }
+
+    // Blocks until check() admits or rejects. Returns true if admitted.
+    bool wait(std::string &reason);
+
+    // Metrics
+    long stalls() const { return stalls_; }            // Times launches were held back
+    uint64_t held_ns() const { return held_ns_; }      // Total time they were held
+    long rejections() const { return rejections_; }    // Stalls that ran into the timeout
+    double worst() const { return worst_; }            // Highest reading over a threshold
+
+private:
+    bool over(std::string &reason);
+
+    PressureThresholds thresholds_;
+    std::string cgroup_parent_;
+    uint64_t stall_start_ = 0;
+    long backoff_ms_ = 0;
+    long stalls_ = 0;
+    uint64_t held_ns_ = 0;
+    long rejections_ = 0;
+    double worst_ = 0;
+};
@@ -0,0 +1,253 @@
+#include "profiler.hpp"
+#include "perf.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// Ring buffer data area per CPU, in pages (must be a power of two)
+#define PROFILE_RING_PAGES 64
+
+bool Profiler::open(const std::string &cgroup_path, const std::string &rootfs, int frequency_hz) {
+    rootfs_ = rootfs;
+    int cgroup_fd = ::open(cgroup_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroup_fd == -1) {
+        std::cerr << "Failed to open cgroup: " << cgroup_path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // cpu-clock works everywhere, including VMs without a PMU. Only user
+    // stacks are collected, which keeps perf_event_paranoid=2 hosts working.
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CPU_CLOCK;
+    attr.freq = 1;
+    attr.sample_freq = frequency_hz;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_callchain_kernel = 1;
+    // Side-band records to map addresses back to binaries and names
+    attr.mmap = 1;
+    attr.mmap2 = 1;
+    attr.comm = 1;
+    attr.task = 1;
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t mmap_size = (PROFILE_RING_PAGES + 1) * page_size;
+    for (int cpu : online_cpus()) {
+        int fd = syscall(SYS_perf_event_open, &attr, cgroup_fd, cpu, -1, PERF_FLAG_PID_CGROUP | PERF_FLAG_FD_CLOEXEC);
+        if (fd == -1) {
+            std::cerr << "Error in perf_event_open (cpu " << cpu << "): " << strerror(errno) << std::endl;
+            ::close(cgroup_fd);
+            close();
+            return false;
+        }
+        void *base = mmap(nullptr, mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            std::cerr << "Failed to map perf ring buffer: " << strerror(errno) << std::endl;
+            ::close(fd);
+            ::close(cgroup_fd);
+            close();
+            return false;
+        }
+        buffers_.push_back({fd, base, PROFILE_RING_PAGES * (size_t)page_size});
+    }
+    ::close(cgroup_fd);
+    return true;
+}
+
+void Profiler::drain() {
+    long page_size = sysconf(_SC_PAGESIZE);
+    std::vector<char> record;
+    for (RingBuffer &buffer : buffers_) {
+        perf_event_mmap_page *header = static_cast<perf_event_mmap_page *>(buffer.base);
+        const char *data = static_cast<const char *>(buffer.base) + page_size;
+
+        uint64_t head = __atomic_load_n(&header->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = header->data_tail;
+        while (tail < head) {
+            const perf_event_header *event =
+                reinterpret_cast<const perf_event_header *>(data + (tail % buffer.size));
+            uint16_t size = event->size;
+            if (size < sizeof(perf_event_header)) {
+                break;
+            }
+
+            // Records may wrap around the end of the buffer; copy them out whole
+            record.resize(size);
+            size_t offset = tail % buffer.size;
+            size_t first = std::min<size_t>(size, buffer.size - offset);
+            memcpy(record.data(), data + offset, first);
+            memcpy(record.data() + first, data, size - first);
+
+            const perf_event_header *copy = reinterpret_cast<const perf_event_header *>(record.data());
+            handle_record(record.data() + sizeof(perf_event_header), copy->type, copy->misc);
+            tail += size;
+        }
+        __atomic_store_n(&header->data_tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+void Profiler::handle_record(const char *body, uint16_t type, uint16_t misc) {
+    switch (type) {
+    case PERF_RECORD_SAMPLE: {
+        // u32 pid, tid; u64 nr; u64 ips[nr]
+        uint32_t pid;
+        uint64_t nr;
+        memcpy(&pid, body, sizeof(pid));
+        memcpy(&nr, body + 8, sizeof(nr));
+        const uint64_t *ips = reinterpret_cast<const uint64_t *>(body + 16);
+
+        Process &process = processes_[pid];
+        std::string stack = process.comm.empty() ? std::to_string(pid) : process.comm;
+        // Callchains are leaf first; folded stacks are root first
+        bool leaf = true;
+        std::vector<std::string> frames;
+        for (uint64_t i = 0; i < nr; i++) {
+            if (ips[i] >= (uint64_t)PERF_CONTEXT_MAX) {
+                continue;  // Context markers such as PERF_CONTEXT_USER
+            }
+            // Return addresses point after the call; look up the call itself
+            frames.push_back(symbolize(process, leaf ? ips[i] : ips[i] - 1));
+            leaf = false;
+        }
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+            stack += ";" + *it;
+        }
+        folded_[stack]++;
+        samples_++;
+        break;
+    }
+    case PERF_RECORD_MMAP2: {
+        // u32 pid, tid; u64 addr, len, pgoff; u32 maj, min; u64 ino, ino_generation;
+        // u32 prot, flags; char filename[]
+        uint32_t pid;
+        uint64_t addr, len, pgoff;
+        memcpy(&pid, body, sizeof(pid));
+        memcpy(&addr, body + 8, sizeof(addr));
+        memcpy(&len, body + 16, sizeof(len));
+        memcpy(&pgoff, body + 24, sizeof(pgoff));
+        const char *filename = body + 64;
+
+        // Later mappings replace whatever they overlap
+        std::vector<Mapping> &mappings = processes_[pid].mappings;
+        for (auto it = mappings.begin(); it != mappings.end();) {
+            if (it->start < addr + len && addr < it->end) {
+                it = mappings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        mappings.push_back({addr, addr + len, pgoff, filename});
+        break;
+    }
+    case PERF_RECORD_COMM: {
+        // u32 pid, tid; char comm[]
+        uint32_t pid, tid;
+        memcpy(&pid, body, sizeof(pid));
+        memcpy(&tid, body + 4, sizeof(tid));
+        Process &process = processes_[pid];
+        if (misc & PERF_RECORD_MISC_COMM_EXEC) {
+            process.mappings.clear();  // The old image is gone
+        }
+        if (pid == tid) {
+            process.comm = body + 8;
+        }
+        break;
+    }
+    case PERF_RECORD_FORK: {
+        // u32 pid, ppid, tid, ptid. New processes inherit the parent's maps.
+        // Buffers are drained one CPU at a time, so the child's own mmap
+        // records may already have been seen; those take precedence.
+        uint32_t pid, ppid, tid;
+        memcpy(&pid, body, sizeof(pid));
+        memcpy(&ppid, body + 4, sizeof(ppid));
+        memcpy(&tid, body + 8, sizeof(tid));
+        if (pid != tid || pid == ppid) {
+            break;
+        }
+        const Process &parent = processes_[ppid];
+        Process &child = processes_[pid];
+        if (child.comm.empty()) {
+            child.comm = parent.comm;
+        }
+        for (const Mapping &inherited : parent.mappings) {
+            bool overlaps = false;
+            for (const Mapping &own : child.mappings) {
+                overlaps = overlaps || (own.start < inherited.end && inherited.start < own.end);
+            }
+            if (!overlaps) {
+                child.mappings.push_back(inherited);
+            }
+        }
+        break;
+    }
+    case PERF_RECORD_LOST: {
+        // u64 id, lost
+        uint64_t lost;
+        memcpy(&lost, body + 8, sizeof(lost));
+        lost_ += lost;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+std::string Profiler::symbolize(const Process &process, uint64_t ip) {
+    for (const Mapping &mapping : process.mappings) {
+        if (ip < mapping.start || ip >= mapping.end) {
+            continue;
+        }
+        // Anonymous and special mappings such as [vdso] have no file to read
+        if (mapping.path.empty() || mapping.path[0] != '/') {
+            return mapping.path.empty() ? "[anon]" : mapping.path;
+        }
+
+        // Paths are reported relative to the container's root; fall back to
+        // the host path for anything mapped from outside the chroot
+        uint64_t file_offset = ip - mapping.start + mapping.pgoff;
+        std::string name = symbols_.get(rootfs_ + mapping.path).lookup(file_offset);
+        if (name.empty()) {
+            name = symbols_.get(mapping.path).lookup(file_offset);
+        }
+        if (!name.empty()) {
+            return name;
+        }
+        std::ostringstream unknown;
+        unknown << "[" << mapping.path.substr(mapping.path.rfind('/') + 1) << "+0x" << std::hex << file_offset << "]";
+        return unknown.str();
+    }
+    return "[unknown]";
+}
+
+bool Profiler::write_folded(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open: " << path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    for (const auto &stack : folded_) {
+        file << stack.first << " " << stack.second << "\n";
+    }
+    return true;
+}
+
+void Profiler::close() {
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (RingBuffer &buffer : buffers_) {
+        munmap(buffer.base, buffer.size + page_size);
+        ::close(buffer.fd);
+    }
+    buffers_.clear();
+}
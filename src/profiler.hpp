@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "symbols.hpp"
+
+// Samples user-space call stacks of every process in a cgroup and
+// aggregates them into folded stacks ("comm;outer;...;leaf count"), the
+// input format of flamegraph.pl and most flame graph viewers
+class Profiler {
+public:
+    Profiler() = default;
+    ~Profiler() { close(); }
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // Starts sampling the cgroup at frequency_hz on every online CPU.
+    // Binaries are symbolized from rootfs, where the container sees them.
+    bool open(const std::string &cgroup_path, const std::string &rootfs, int frequency_hz);
+
+    // Consumes everything in the ring buffers. Call periodically so they do
+    // not overflow, and once more after the container exits.
+    void drain();
+
+    // Writes the aggregated folded stacks to path
+    bool write_folded(const std::string &path) const;
+
+    uint64_t samples() const { return samples_; }
+    uint64_t lost() const { return lost_; }
+
+    void close();
+
+private:
+    // One executable mapping of a process, as reported by PERF_RECORD_MMAP2
+    struct Mapping {
+        uint64_t start;
+        uint64_t end;
+        uint64_t pgoff;
+        std::string path;  // Path inside the container
+    };
+    struct Process {
+        std::string comm;
+        std::vector<Mapping> mappings;
+    };
+    struct RingBuffer {
+        int fd;
+        void *base;
+        size_t size;  // Data area size, excluding the header page
+    };
+
+    void handle_record(const char *record, uint16_t type, uint16_t misc);
+    std::string symbolize(const Process &process, uint64_t ip);
+
+    std::string rootfs_;
+    std::vector<RingBuffer> buffers_;
+    std::map<pid_t, Process> processes_;
+    std::map<std::string, uint64_t> folded_;
+    SymbolCache symbols_;
+    uint64_t samples_ = 0;
+    uint64_t lost_ = 0;
+};
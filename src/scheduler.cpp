@@ -0,0 +1,86 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <sched.h>
+#include <unistd.h>
+
+HostCapacity host_capacity(double cpu_overcommit, double mem_overcommit) {
+    // The affinity mask rather than the online count, so a dockher pinned to
+    // a few CPUs does not pack them as if it had the whole host
+    cpu_set_t set;
+    long cpus = sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : sysconf(_SC_NPROCESSORS_ONLN);
+    long long mem_mb = static_cast<long long>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+
+    HostCapacity capacity;
+    capacity.cpu_pct = static_cast<long long>(cpus * 100 * cpu_overcommit);
+    capacity.mem_mb = static_cast<long long>(mem_mb * mem_overcommit);
+    return capacity;
+}
+
+bool AdmissionScheduler::enqueue(size_t id, const ResourceRequest &request) {
+    if (request.cpu_pct > capacity_.cpu_pct || request.mem_mb > capacity_.mem_mb) {
+        return false;
+    }
+    Entry entry{id, request, next_order_++};
+    auto it = std::upper_bound(queue_.begin(), queue_.end(), entry, [](const Entry &a, const Entry &b) {
+        return a.request.priority != b.request.priority ? a.request.priority > b.request.priority : a.order < b.order;
+    });
+    queue_.insert(it, entry);
+    return true;
+}
+
+std::vector<size_t> AdmissionScheduler::admit(size_t max_count) {
+    std::vector<size_t> ids;
+    // The first request that does not fit holds a reservation: requests
+    // behind it are only admitted into what it leaves over, and never into
+    // a resource it is short of, so releases eventually make room for it
+    // instead of going to a stream of smaller requests (EASY backfill, with
+    // capacity in place of runtime estimates)
+    bool reserving = false;
+    ResourceRequest reserved;
+    for (auto it = queue_.begin(); it != queue_.end() && ids.size() < max_count;) {
+        const ResourceRequest &request = it->request;
+        bool fits = committed_.cpu_pct + request.cpu_pct <= capacity_.cpu_pct &&
+                    committed_.mem_mb + request.mem_mb <= capacity_.mem_mb;
+        if (fits && reserving) {
+            fits = (request.cpu_pct == 0 || committed_.cpu_pct + reserved.cpu_pct + request.cpu_pct <= capacity_.cpu_pct) &&
+                   (request.mem_mb == 0 || committed_.mem_mb + reserved.mem_mb + request.mem_mb <= capacity_.mem_mb);
+        }
+        if (!fits) {
+            if (!reserving) {
+                reserving = true;
+                reserved = request;
+            }
+            ++it;
+            continue;
+        }
+        committed_.cpu_pct += request.cpu_pct;
+        committed_.mem_mb += request.mem_mb;
+        peak_.cpu_pct = std::max(peak_.cpu_pct, committed_.cpu_pct);
+        peak_.mem_mb = std::max(peak_.mem_mb, committed_.mem_mb);
+        ids.push_back(it->id);
+        admitted_.push_back(*it);
+        it = queue_.erase(it);
+    }
+    return ids;
+}
+
+void AdmissionScheduler::release(size_t id) {
+    for (auto it = admitted_.begin(); it != admitted_.end(); ++it) {
+        if (it->id == id) {
+            committed_.cpu_pct -= it->request.cpu_pct;
+            committed_.mem_mb -= it->request.mem_mb;
+            admitted_.erase(it);
+            return;
+        }
+    }
+}
+
+std::vector<size_t> AdmissionScheduler::drain() {
+    std::vector<size_t> ids;
+    for (const Entry &entry : queue_) {
+        ids.push_back(entry.id);
+    }
+    queue_.clear();
+    return ids;
+}
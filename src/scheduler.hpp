@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// What the host can hold, in the units of Limits: CPU in percent of one
+// CPU (400 = four CPUs) and memory in MB
+struct HostCapacity {
+    long long cpu_pct = 0;
+    long long mem_mb = 0;
+};
+
+// Reads the CPUs we may run on and the host's physical memory, each scaled
+// by its overcommit ratio (1.0 = admit no more than the host has)
+HostCapacity host_capacity(double cpu_overcommit, double mem_overcommit);
+
+// What one container asks for while it runs
+struct ResourceRequest {
+    long long cpu_pct = 0;
+    long long mem_mb = 0;
+    int priority = 0;        // Higher goes first
+};
+
+// Admits containers only while the sum of their requests fits the host's
+// capacity, and queues the rest. Waiting requests are considered in
+// priority order, then in the order they were queued. The first one that
+// does not fit yet reserves its share: smaller ones behind it are still
+// admitted (backfill), but only where they cannot delay it.
+class AdmissionScheduler {
+public:
+    explicit AdmissionScheduler(const HostCapacity &capacity) : capacity_(capacity) {}
+
+    // Queues request under id. Returns false if it would not fit even on an
+    // empty host, so it can never be admitted.
+    bool enqueue(size_t id, const ResourceRequest &request);
+
+    // Admits as many waiting requests as fit, at most max_count, and
+    // returns their ids in the order to launch them
+    std::vector<size_t> admit(size_t max_count);
+
+    // Returns what id holds to the pool once its container is gone
+    void release(size_t id);
+
+    // Removes every waiting request and returns their ids
+    std::vector<size_t> drain();
+
+    size_t waiting() const { return queue_.size(); }
+    const HostCapacity &committed() const { return committed_; }
+    const HostCapacity &peak() const { return peak_; }
+
+private:
+    struct Entry {
+        size_t id;
+        ResourceRequest request;
+        size_t order;
+    };
+
+    HostCapacity capacity_;
+    HostCapacity committed_;
+    HostCapacity peak_;
+    std::vector<Entry> queue_;       // Kept sorted: priority, then order
+    std::vector<Entry> admitted_;
+    size_t next_order_ = 0;
+};
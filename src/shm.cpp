@@ -0,0 +1,128 @@
+#include "shm.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+// A directory on a different device than its parent is a mount point
+static bool is_mounted(const std::string &path) {
+    struct stat dir, parent;
+    return stat(path.c_str(), &dir) == 0 && stat(SHM_DIR, &parent) == 0 && dir.st_dev != parent.st_dev;
+}
+
+// Unmounts and removes the volume. The caller holds the exclusive lock.
+static void remove_volume(const std::string &path) {
+    if (is_mounted(path) && umount2(path.c_str(), MNT_DETACH) == -1) {
+        std::cerr << "Failed to unmount: " << path << " — " << strerror(errno) << std::endl;
+        return;
+    }
+    rmdir(path.c_str());
+    unlink((path + ".lock").c_str());
+}
+
+bool ShmVolume::open(const std::string &group, long long size_mb, bool hugetlb) {
+    if (group.empty() || group.find('/') != std::string::npos || group[0] == '.') {
+        std::cerr << "Invalid shm group name: " << group << std::endl;
+        return false;
+    }
+    if (size_mb <= 0) {
+        std::cerr << "Shared memory size must be a positive number of MB" << std::endl;
+        return false;
+    }
+    mkdir(STATE_DIR, 0755);
+    mkdir(SHM_DIR, 0755);
+    std::string path = std::string(SHM_DIR) + "/" + group;
+    std::string lock_path = path + ".lock";
+
+    // Users hold the lock shared; it is only taken exclusively to mount the
+    // volume, so two first users cannot both mount it and a last user
+    // cannot unmount it under us
+    for (int operation = LOCK_SH;;) {
+        if (lock_fd_ == -1) {
+            lock_fd_ = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        }
+        if (lock_fd_ == -1 || flock(lock_fd_, operation) == -1) {
+            std::cerr << "Failed to lock: " << lock_path << " — " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+        // The last user may have removed the lock file while we waited on it
+        struct stat locked, current;
+        if (fstat(lock_fd_, &locked) == -1 || stat(lock_path.c_str(), &current) == -1 ||
+            locked.st_ino != current.st_ino) {
+            ::close(lock_fd_);
+            lock_fd_ = -1;
+            continue;
+        }
+        if (is_mounted(path)) {
+            break;
+        }
+        if (operation == LOCK_SH) {
+            operation = LOCK_EX;
+            continue;
+        }
+
+        std::string data = "size=" + std::to_string(size_mb) + "M,mode=1777";
+        if ((mkdir(path.c_str(), 01777) == -1 && errno != EEXIST) ||
+            mount(hugetlb ? "hugetlbfs" : "tmpfs", path.c_str(), hugetlb ? "hugetlbfs" : "tmpfs", MS_NOSUID | MS_NODEV,
+                  data.c_str()) == -1) {
+            std::cerr << "Failed to mount shared memory volume: " << path << " — " << strerror(errno) << std::endl;
+            rmdir(path.c_str());
+            unlink(lock_path.c_str());
+            close();
+            return false;
+        }
+        // Converting back to shared lets the other users of the group in
+        flock(lock_fd_, LOCK_SH);
+        break;
+    }
+    path_ = path;
+    return true;
+}
+
+void ShmVolume::close() {
+    if (lock_fd_ == -1) {
+        return;
+    }
+    // If nobody else holds the lock we are the last user. A failed
+    // conversion also drops our shared lock, so of several users leaving
+    // at once the last one still gets it.
+    if (!path_.empty() && flock(lock_fd_, LOCK_EX | LOCK_NB) == 0) {
+        remove_volume(path_);
+    }
+    ::close(lock_fd_);
+    lock_fd_ = -1;
+    path_.clear();
+}
+
+int collect_shm_volumes() {
+    int collected = 0;
+    DIR *dir = opendir(SHM_DIR);
+    if (!dir) {
+        return 0;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() <= 5 || name.compare(name.size() - 5, 5, ".lock") != 0) {
+            continue;
+        }
+        std::string path = std::string(SHM_DIR) + "/" + name.substr(0, name.size() - 5);
+        int fd = ::open((path + ".lock").c_str(), O_RDWR | O_CLOEXEC);
+        if (fd != -1 && flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            std::cout << "Removing unused shm volume " << path << std::endl;
+            remove_volume(path);
+            collected++;
+        }
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+    closedir(dir);
+    return collected;
+}
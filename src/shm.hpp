@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include "state.hpp"
+
+// Host directories backing shared /dev/shm volumes, one per group
+#define SHM_DIR STATE_DIR "/shm"
+
+// A tmpfs (or hugetlbfs) mounted at SHM_DIR/<group> and bind-mounted onto
+// /dev/shm of every container in the group, so they can share memory with
+// shm_open()/mmap() instead of going through files or sockets.
+//
+// Each supervisor using the volume holds a shared flock() on
+// SHM_DIR/<group>.lock; the first one in mounts it under an exclusive lock,
+// and whoever finds itself the last one out unmounts it. The lock dies with the supervisor,
+// so "dockher gc" can unmount volumes left behind by killed supervisors.
+class ShmVolume {
+public:
+    ShmVolume() = default;
+    ~ShmVolume() { close(); }
+
+    ShmVolume(const ShmVolume &) = delete;
+    ShmVolume &operator=(const ShmVolume &) = delete;
+
+    // Joins the group's volume, mounting it with size_mb if it does not
+    // exist yet. A volume that is already mounted keeps its original size.
+    bool open(const std::string &group, long long size_mb, bool hugetlb);
+
+    // Host path to bind-mount into containers
+    const std::string &path() const { return path_; }
+
+    // Leaves the group, unmounting the volume if nobody else uses it
+    void close();
+
+private:
+    std::string path_;
+    int lock_fd_ = -1;
+};
+
+// Unmounts volumes that no supervisor holds any more. Returns how many.
+int collect_shm_volumes();
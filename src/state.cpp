@@ -0,0 +1,188 @@
+#include "state.hpp"
+#include "cgroup.hpp"
+#include "net.hpp"
+#include "shm.hpp"
+#include "tenant.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <set>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static std::string state_path(const std::string &id) {
+    return std::string(STATE_DIR) + "/" + id;
+}
+
+bool save_state(const ContainerState &state) {
+    mkdir(STATE_DIR, 0755);
+
+    // Write to a temporary file and rename it over the old one, so readers
+    // never see a half-written state
+    std::string path = state_path(std::to_string(state.pid));
+    std::string tmp_path = path + ".tmp";
+    std::ofstream file(tmp_path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open: " << tmp_path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    file << "pid=" << state.pid << "\n"
+         << "supervisor=" << state.supervisor << "\n"
+         << "cgroup=" << state.cgroup << "\n"
+         << "rootfs=" << state.rootfs << "\n"
+         << "cmd=" << state.cmd << "\n"
+         << "thp=" << state.thp << "\n"
+         << "ksm=" << state.ksm << "\n";
+    file.close();
+    if (!file || rename(tmp_path.c_str(), path.c_str()) == -1) {
+        std::cerr << "Failed to save state: " << path << " — " << strerror(errno) << std::endl;
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load_state(const std::string &id, ContainerState &state) {
+    std::ifstream file(state_path(id));
+    if (!file.is_open()) {
+        std::cerr << "No such container: " << id << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "pid" || key == "supervisor") {
+            char *end = nullptr;
+            errno = 0;
+            long number = strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || errno == ERANGE || number <= 0 || number > INT_MAX) {
+                std::cerr << "Corrupt state of container " << id << ": " << line << std::endl;
+                return false;
+            }
+            (key == "pid" ? state.pid : state.supervisor) = number;
+        } else if (key == "cgroup") {
+            state.cgroup = value;
+        } else if (key == "rootfs") {
+            state.rootfs = value;
+        } else if (key == "cmd") {
+            state.cmd = value;
+        } else if (key == "thp") {
+            state.thp = value;
+        } else if (key == "ksm") {
+            state.ksm = value == "1";
+        }
+    }
+    return state.pid != -1 && !state.cgroup.empty();
+}
+
+void remove_state(pid_t pid) {
+    unlink(state_path(std::to_string(pid)).c_str());
+}
+
+std::vector<std::string> list_states() {
+    std::vector<std::string> ids;
+    DIR *dir = opendir(STATE_DIR);
+    if (!dir) {
+        return ids;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        // Skip ".", ".." and half-written ".tmp" files
+        if (name.empty() || name.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        ids.push_back(name);
+    }
+    closedir(dir);
+    return ids;
+}
+
+int collect_garbage() {
+    int collected = 0;
+    std::set<std::string> live_cgroups;
+    for (const std::string &id : list_states()) {
+        ContainerState state;
+        if (!load_state(id, state)) {
+            continue;
+        }
+        if (state.supervisor > 0 && (kill(state.supervisor, 0) == 0 || errno == EPERM)) {
+            live_cgroups.insert(state.cgroup);
+            continue;
+        }
+        std::cout << "Removing container " << id << " (supervisor " << state.supervisor << " is gone)" << std::endl;
+        kill_cgroup(state.cgroup);
+        remove_cgroup(state.cgroup);
+        remove_state(state.pid);
+        collected++;
+    }
+
+    // Cgroups whose supervisor died before it could save any state. Recent
+    // ones may belong to a launch in progress that has not saved it yet.
+    time_t now = time(nullptr);
+
+    // Containers of tenants sit a few levels further down
+    std::vector<std::string> parents = {CGROUP_ROOT};
+    for (const std::string &tenant : list_tenants()) {
+        parents.push_back(tenant_cgroup(tenant));
+    }
+    for (const std::string &parent : parents) {
+        DIR *dir = opendir(parent.c_str());
+        if (!dir) {
+            continue;
+        }
+        while (dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            std::string path = parent + "/" + name;
+            if (name.compare(0, 8, "dockher_") != 0 || live_cgroups.count(path)) {
+                continue;
+            }
+            // Pod cgroups are named after their supervisor, and go with it along
+            // with the infra container and anything else still inside
+            if (name.compare(0, 12, "dockher_pod_") == 0) {
+                pid_t supervisor = atoi(name.c_str() + 12);
+                if (supervisor <= 0 || kill(supervisor, 0) == 0 || errno == EPERM) {
+                    continue;
+                }
+                kill_cgroup(path);
+                if (DIR *pod = opendir(path.c_str())) {
+                    while (dirent *child = readdir(pod)) {
+                        if (strncmp(child->d_name, "dockher_", 8) == 0) {
+                            rmdir((path + "/" + child->d_name).c_str());
+                        }
+                    }
+                    closedir(pod);
+                }
+                if (rmdir(path.c_str()) == 0) {
+                    std::cout << "Removed pod cgroup " << path << " (supervisor " << supervisor << " is gone)" << std::endl;
+                    collected++;
+                }
+                continue;
+            }
+            struct stat st;
+            std::string procs;
+            if (stat(path.c_str(), &st) == -1 || now - st.st_mtime < 10) {
+                continue;
+            }
+            if (read_file(path + "/cgroup.procs", procs) && procs.empty() && rmdir(path.c_str()) == 0) {
+                std::cout << "Removed empty cgroup " << path << std::endl;
+                collected++;
+            }
+        }
+        closedir(dir);
+    }
+    return collected + collect_shm_volumes() + collect_network();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// On-disk state of running containers, one file per container
+#define STATE_DIR "/run/dockher"
+
+// What other dockher invocations need to know about a running container.
+// The container id is the host pid of its init process.
+struct ContainerState {
+    pid_t pid = -1;              // Host pid of the container's init process
+    pid_t supervisor = -1;       // Pid of the dockher process waiting on it
+    std::string cgroup;          // Full path of the container's cgroup
+    std::string rootfs;          // Root filesystem the container was chrooted to
+    std::string cmd;             // Command the container was started with
+    std::string thp = "inherit"; // THP policy of its processes (see ThpPolicy), for dockher exec
+    bool ksm = false;            // Whether its memory is opted into KSM, for dockher exec
+};
+
+// Writes the state file for the container, replacing it atomically
+bool save_state(const ContainerState &state);
+
+// Loads the state of the container with the given id
+bool load_state(const std::string &id, ContainerState &state);
+
+// Removes the container's state file
+void remove_state(pid_t pid);
+
+// Ids of every container with a state file
+std::vector<std::string> list_states();
+
+// Cleans up after supervisors that died without tearing down their
+// container: kills and removes the cgroups of state files whose supervisor
+// is gone, removes empty dockher_* cgroups with no state file at all (in
+// the root cgroup or a tenant's), unmounts shared memory volumes nobody
+// uses any more, and releases the addresses of containers that are gone.
+// Returns the number of containers cleaned up.
+int collect_garbage();
@@ -0,0 +1,126 @@
+#include "symbols.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static std::string demangle(const char *name) {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || !demangled) {
+        return name;
+    }
+    std::string result = demangled;
+    free(demangled);
+    return result;
+}
+
+bool ElfSymbols::load(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    const char *base = static_cast<const char *>(map);
+
+    const Elf64_Ehdr *ehdr = reinterpret_cast<const Elf64_Ehdr *>(base);
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64
+        || ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(Elf64_Phdr) > size
+        || ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(Elf64_Shdr) > size) {
+        munmap(map, size);
+        return false;
+    }
+
+    const Elf64_Phdr *phdrs = reinterpret_cast<const Elf64_Phdr *>(base + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD) {
+            segments_.push_back({phdrs[i].p_offset, phdrs[i].p_vaddr, phdrs[i].p_filesz});
+        }
+    }
+
+    // Prefer the full symbol table, fall back to the dynamic one
+    const Elf64_Shdr *shdrs = reinterpret_cast<const Elf64_Shdr *>(base + ehdr->e_shoff);
+    for (uint32_t wanted : {SHT_SYMTAB, SHT_DYNSYM}) {
+        for (int i = 0; i < ehdr->e_shnum; i++) {
+            const Elf64_Shdr &section = shdrs[i];
+            if (section.sh_type != wanted || section.sh_link >= ehdr->e_shnum) {
+                continue;
+            }
+            const Elf64_Shdr &strtab = shdrs[section.sh_link];
+            if (section.sh_offset + section.sh_size > size || strtab.sh_offset + strtab.sh_size > size) {
+                continue;
+            }
+            const Elf64_Sym *syms = reinterpret_cast<const Elf64_Sym *>(base + section.sh_offset);
+            size_t count = section.sh_size / sizeof(Elf64_Sym);
+            for (size_t j = 0; j < count; j++) {
+                if (ELF64_ST_TYPE(syms[j].st_info) != STT_FUNC || syms[j].st_value == 0
+                    || syms[j].st_name >= strtab.sh_size) {
+                    continue;
+                }
+                const char *name = base + strtab.sh_offset + syms[j].st_name;
+                symbols_.push_back({syms[j].st_value, syms[j].st_size, demangle(name)});
+            }
+        }
+        if (!symbols_.empty()) {
+            break;
+        }
+    }
+    munmap(map, size);
+
+    std::sort(symbols_.begin(), symbols_.end(), [](const Symbol &a, const Symbol &b) { return a.start < b.start; });
+    return true;
+}
+
+std::string ElfSymbols::lookup(uint64_t file_offset) const {
+    // Translate the file offset into the address the symbols are expressed in
+    uint64_t vaddr = 0;
+    bool found = false;
+    for (const Segment &segment : segments_) {
+        if (file_offset >= segment.offset && file_offset < segment.offset + segment.filesz) {
+            vaddr = file_offset - segment.offset + segment.vaddr;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        return "";
+    }
+
+    auto it = std::upper_bound(symbols_.begin(), symbols_.end(), vaddr,
+                               [](uint64_t addr, const Symbol &s) { return addr < s.start; });
+    if (it == symbols_.begin()) {
+        return "";
+    }
+    --it;
+    // Symbols with no recorded size are taken to extend to the next one
+    if (it->size != 0 && vaddr >= it->start + it->size) {
+        return "";
+    }
+    return it->name;
+}
+
+const ElfSymbols &SymbolCache::get(const std::string &path) {
+    auto it = files_.find(path);
+    if (it == files_.end()) {
+        std::unique_ptr<ElfSymbols> symbols(new ElfSymbols());
+        symbols->load(path);
+        it = files_.emplace(path, std::move(symbols)).first;
+    }
+    return *it->second;
+}
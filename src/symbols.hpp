@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Function symbols of one ELF file, read from .symtab (or .dynsym for
+// stripped binaries), used to turn sampled addresses into names
+class ElfSymbols {
+public:
+    // Loads the symbols of the file at path. Returns false if it is not a
+    // readable ELF64 file; lookups then always fail.
+    bool load(const std::string &path);
+
+    // Name of the function containing the given file offset, demangled.
+    // Empty if no symbol covers it.
+    std::string lookup(uint64_t file_offset) const;
+
+private:
+    struct Symbol {
+        uint64_t start;
+        uint64_t size;
+        std::string name;
+    };
+    struct Segment {
+        uint64_t offset;
+        uint64_t vaddr;
+        uint64_t filesz;
+    };
+
+    std::vector<Symbol> symbols_;    // Sorted by start address
+    std::vector<Segment> segments_;  // PT_LOAD segments, to map file offsets to addresses
+};
+
+// Caches loaded symbol tables by host path
+class SymbolCache {
+public:
+    const ElfSymbols &get(const std::string &path);
+
+private:
+    std::map<std::string, std::unique_ptr<ElfSymbols>> files_;
+};
@@ -0,0 +1,167 @@
+#include "tenant.hpp"
+#include "cgroup.hpp"
+#include "include/cxxopts.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <unistd.h>
+
+bool valid_tenant(const std::string &tenant) {
+    std::stringstream parts(tenant);
+    std::string part;
+    if (tenant.empty() || tenant.back() == '/') {
+        return false;
+    }
+    while (std::getline(parts, part, '/')) {
+        // dockher_* names are containers and pods, not tenants
+        if (part.empty() || part == "." || part == ".." || part.compare(0, 8, "dockher_") == 0 ||
+            part.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.") != std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string tenant_cgroup(const std::string &tenant) {
+    return std::string(TENANT_SLICE) + "/" + tenant;
+}
+
+bool ensure_tenant(const std::string &tenant, std::string &path) {
+    if (!valid_tenant(tenant)) {
+        std::cerr << "Invalid tenant name: " << tenant << std::endl;
+        return false;
+    }
+    enable_controllers(CGROUP_ROOT);
+    path = TENANT_SLICE;
+    if (!create_cgroup(path)) {
+        return false;
+    }
+    std::stringstream parts(tenant);
+    std::string part;
+    while (std::getline(parts, part, '/')) {
+        enable_controllers(path);
+        path += "/" + part;
+        if (!create_cgroup(path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds the tenants under dir (relative name prefix) to tenants, depth first
+static void find_tenants(const std::string &dir, const std::string &prefix, std::vector<std::string> &tenants) {
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    while (dirent *entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (entry->d_type != DT_DIR || name == "." || name == ".." || name.compare(0, 8, "dockher_") == 0) {
+            continue;
+        }
+        tenants.push_back(prefix + name);
+        find_tenants(dir + "/" + name, prefix + name + "/", tenants);
+    }
+    closedir(d);
+}
+
+std::vector<std::string> list_tenants() {
+    std::vector<std::string> tenants;
+    find_tenants(TENANT_SLICE, "", tenants);
+    return tenants;
+}
+
+// Number of containers and pods directly in a tenant
+static int count_members(const std::string &path) {
+    int members = 0;
+    if (DIR *d = opendir(path.c_str())) {
+        while (dirent *entry = readdir(d)) {
+            members += strncmp(entry->d_name, "dockher_", 8) == 0;
+        }
+        closedir(d);
+    }
+    return members;
+}
+
+int tenant_main(int argc, char *argv[]) {
+    cxxopts::Options options("dockher tenant", "Manage tenants: cgroups that share the machine by weight");
+    options.add_options()
+        ("action", "set, list or remove", cxxopts::value<std::string>())
+        ("name", "Tenant name, e.g. team-a or team-a/ci", cxxopts::value<std::string>())
+        ("cpu-weight", "Share of CPU relative to other tenants (1-10000, default 100)", cxxopts::value<int>())
+        ("io-weight", "Share of IO relative to other tenants (1-10000, default 100)", cxxopts::value<int>())
+        ("m,mem", "Memory budget of all the tenant's containers together (MB)", cxxopts::value<long long>())
+        ("h,help", "Print usage");
+    options.parse_positional({"action", "name"});
+    options.positional_help("set|list|remove [<name>]");
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("action")) {
+        std::cout << options.help() << std::endl;
+        return result.count("help") ? 0 : 1;
+    }
+
+    std::string action = result["action"].as<std::string>();
+    if (action == "list") {
+        std::cout << std::left << std::setw(24) << "tenant" << std::right << std::setw(12) << "cpu.weight"
+                  << std::setw(12) << "io.weight" << std::setw(14) << "memory.max" << std::setw(16) << "memory.current"
+                  << std::setw(12) << "containers" << std::endl;
+        for (const std::string &tenant : list_tenants()) {
+            std::string path = tenant_cgroup(tenant);
+            std::string io_weight;
+            read_file(path + "/io.weight", io_weight);
+            io_weight = io_weight.compare(0, 8, "default ") == 0 ? io_weight.substr(8, io_weight.find('\n') - 8) : "-";
+            long long cpu_weight = read_cgroup_value(path + "/cpu.weight");
+            long long mem_max = read_cgroup_value(path + "/memory.max");
+            long long mem_current = read_cgroup_value(path + "/memory.current");
+            std::cout << std::left << std::setw(24) << tenant << std::right
+                      << std::setw(12) << (cpu_weight == -1 ? "-" : std::to_string(cpu_weight))
+                      << std::setw(12) << io_weight
+                      << std::setw(14) << (mem_max == -1 ? "max" : std::to_string(mem_max / (1024 * 1024)) + " MB")
+                      << std::setw(16) << (mem_current == -1 ? "-" : std::to_string(mem_current / (1024 * 1024)) + " MB")
+                      << std::setw(12) << count_members(path) << std::endl;
+        }
+        return 0;
+    }
+
+    if (!result.count("name")) {
+        std::cerr << "Missing tenant name" << std::endl;
+        return 1;
+    }
+    std::string tenant = result["name"].as<std::string>();
+    if (action == "set") {
+        Limits limits;
+        limits.cpu_weight = result.count("cpu-weight") ? result["cpu-weight"].as<int>() : -1;
+        limits.io_weight = result.count("io-weight") ? result["io-weight"].as<int>() : -1;
+        limits.mem_mb = result.count("mem") ? result["mem"].as<long long>() : -1;
+        std::string path;
+        if (!validate_limits(limits) || !ensure_tenant(tenant, path)) {
+            return 1;
+        }
+        if (!apply_limits(path, limits)) {
+            std::cerr << "Limits of tenant " << tenant << " left unchanged" << std::endl;
+            return 1;
+        }
+        std::cout << "Tenant " << tenant << ": " << path << std::endl;
+        return 0;
+    }
+    if (action == "remove") {
+        if (!valid_tenant(tenant)) {
+            std::cerr << "Invalid tenant name: " << tenant << std::endl;
+            return 1;
+        }
+        // Only empty tenants can go; rmdir refuses the rest
+        std::string path = tenant_cgroup(tenant);
+        if (rmdir(path.c_str()) == -1) {
+            std::cerr << "Failed to remove tenant: " << path << " — " << strerror(errno) << std::endl;
+            return 1;
+        }
+        std::cout << "Removed tenant " << tenant << std::endl;
+        return 0;
+    }
+    std::cerr << "Unknown action: " << action << " (available: set, list, remove)" << std::endl;
+    return 1;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "cgroup.hpp"
+
+// Cgroup the tenants' cgroups are created in, so containers stay out of
+// the root cgroup and tenants share the machine by weight
+#define TENANT_SLICE CGROUP_ROOT "/dockher.slice"
+
+// Checks a tenant name: one or more "/"-separated components of letters,
+// digits, '-', '_' and '.', nesting a tenant under another (e.g. "team-a/ci")
+bool valid_tenant(const std::string &tenant);
+
+// Full cgroup path of a tenant
+std::string tenant_cgroup(const std::string &tenant);
+
+// Creates the tenant's cgroup and every cgroup above it, enabling the
+// controllers on the way down so the weights and limits of each level are
+// enforced. Fills path with the tenant's cgroup.
+bool ensure_tenant(const std::string &tenant, std::string &path);
+
+// Names of every tenant, nested ones as "parent/child"
+std::vector<std::string> list_tenants();
+
+// dockher tenant set <name> [--cpu-weight N] [--io-weight N] [--mem MB]
+// dockher tenant list | remove <name>
+int tenant_main(int argc, char *argv[]);
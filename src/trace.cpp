@@ -0,0 +1,79 @@
+#include "trace.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+void Trace::add(const std::string &name, uint64_t start_ns, uint64_t end_ns, pid_t pid) {
+    spans_.push_back({name, start_ns, end_ns, pid});
+}
+
+void Trace::add(const std::vector<TraceSpan> &spans) {
+    spans_.insert(spans_.end(), spans.begin(), spans.end());
+}
+
+bool Trace::write(const std::string &path, const std::string &format) const {
+    if (format != "json" && format != "binary") {
+        std::cerr << "Unknown trace format: " << format << " (expected json or binary)" << std::endl;
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open: " << path << " — " << strerror(errno) << std::endl;
+        return false;
+    }
+    return format == "json" ? write_json(file) : write_binary(file);
+}
+
+bool Trace::write_json(std::ostream &out) const {
+    // Timestamps are made relative to the first span so the viewer opens at zero
+    uint64_t origin = UINT64_MAX;
+    for (const TraceSpan &span : spans_) {
+        origin = std::min(origin, span.start_ns);
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < spans_.size(); i++) {
+        const TraceSpan &span = spans_[i];
+        // Complete ("X") events in microseconds
+        out << (i ? "," : "") << "\n{\"name\":\"" << span.name << "\",\"cat\":\"dockher\",\"ph\":\"X\""
+            << ",\"ts\":" << (span.start_ns - origin) / 1000.0
+            << ",\"dur\":" << (span.end_ns - span.start_ns) / 1000.0
+            << ",\"pid\":" << span.pid << ",\"tid\":" << span.pid << "}";
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+template <typename T>
+static void put(std::ostream &out, T value) {
+    // Little endian regardless of host order
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out.put(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff));
+    }
+}
+
+bool Trace::write_binary(std::ostream &out) const {
+    out.write("DKTR", 4);
+    put<uint32_t>(out, 1);
+    put<uint32_t>(out, spans_.size());
+    for (const TraceSpan &span : spans_) {
+        put<uint64_t>(out, span.start_ns);
+        put<uint64_t>(out, span.end_ns);
+        put<uint32_t>(out, span.pid);
+        put<uint16_t>(out, span.name.size());
+        out.write(span.name.data(), span.name.size());
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// Current CLOCK_MONOTONIC time in nanoseconds. Comparable across processes,
+// so child-side timestamps line up with the supervisor's.
+uint64_t monotonic_ns();
+
+// One timed phase of a container's lifecycle
+struct TraceSpan {
+    std::string name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    pid_t pid;  // Process the phase ran in (supervisor or container)
+};
+
+// Collects spans and writes them as Chrome trace JSON (chrome://tracing,
+// Perfetto) or a compact binary format:
+//   "DKTR" u32 version u32 count, then per span:
+//   u64 start_ns u64 end_ns u32 pid u16 name_len char name[name_len]
+// All integers are little endian.
+class Trace {
+public:
+    void add(const std::string &name, uint64_t start_ns, uint64_t end_ns, pid_t pid);
+    void add(const std::vector<TraceSpan> &spans);
+
+    bool write(const std::string &path, const std::string &format) const;
+
+    const std::vector<TraceSpan> &spans() const { return spans_; }
+
+private:
+    bool write_json(std::ostream &out) const;
+    bool write_binary(std::ostream &out) const;
+
+    std::vector<TraceSpan> spans_;
+};
@@ -0,0 +1,75 @@
+#include "work_pool.hpp"
+
+// Index of the pool worker running on this thread, or -1 outside the pool
+static thread_local long worker_index = -1;
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    for (int i = 0; i < threads; i++) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 0; i < threads; i++) {
+        threads_.emplace_back(&WorkStealingPool::work, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    size_t target = worker_index >= 0 ? worker_index : next_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        pending_++;
+    }
+    wake_.notify_one();
+}
+
+bool WorkStealingPool::take(size_t self, std::function<void()> &task) {
+    for (size_t i = 0; i < queues_.size(); i++) {
+        size_t victim = (self + i) % queues_.size();
+        std::lock_guard<std::mutex> lock(queues_[victim]->mutex);
+        std::deque<std::function<void()>> &tasks = queues_[victim]->tasks;
+        if (tasks.empty()) {
+            continue;
+        }
+        // Newest of our own, still warm in cache; oldest of someone else's
+        if (victim == self) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        } else {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        pending_--;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::work(size_t self) {
+    worker_index = self;
+    for (;;) {
+        std::function<void()> task;
+        if (take(self, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_.wait(lock, [this]() { return pending_ > 0 || stopping_; });
+        if (stopping_ && pending_ == 0) {
+            return;
+        }
+    }
+}
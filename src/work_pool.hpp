@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. A worker takes its
+// own newest task first and, when it runs dry, steals the oldest task of
+// another worker, so uneven tasks (a slow cgroup setup next to a quick
+// teardown) do not leave threads idle while others have a backlog.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int threads);
+
+    // Runs every task already submitted, then joins the workers
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Queues a task: on the calling worker's own deque when called from a
+    // task, otherwise on the next worker's in turn
+    void submit(std::function<void()> task);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void work(size_t self);
+    bool take(size_t self, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};
+    std::atomic<long> pending_{0};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
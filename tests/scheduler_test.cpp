@@ -0,0 +1,82 @@
+// Admission scheduler checks, runnable without root or cgroups:
+//   g++ -std=c++17 -Isrc tests/scheduler_test.cpp src/scheduler.cpp -o scheduler_test && ./scheduler_test
+
+#include "scheduler.hpp"
+
+#include <iostream>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #condition << std::endl; \
+            failures++;                                                                   \
+        }                                                                                 \
+    } while (0)
+
+static ResourceRequest request(long long cpu_pct, long long mem_mb, int priority = 0) {
+    ResourceRequest r;
+    r.cpu_pct = cpu_pct;
+    r.mem_mb = mem_mb;
+    r.priority = priority;
+    return r;
+}
+
+// A large job at the head of the queue is admitted once the running jobs
+// are gone, even while small jobs keep arriving behind it
+static void large_head_is_not_starved() {
+    HostCapacity capacity;
+    capacity.cpu_pct = 400;
+    capacity.mem_mb = 1000;
+    AdmissionScheduler scheduler(capacity);
+
+    CHECK(scheduler.enqueue(0, request(100, 300)));
+    CHECK(scheduler.admit(10) == std::vector<size_t>{0});
+
+    CHECK(scheduler.enqueue(1, request(400, 800, 1)));
+    size_t next = 2;
+    for (int round = 0; round < 5; round++) {
+        CHECK(scheduler.enqueue(next++, request(100, 100)));
+        CHECK(scheduler.admit(10).empty());
+    }
+
+    scheduler.release(0);
+    CHECK(scheduler.admit(10) == std::vector<size_t>{1});
+    scheduler.release(1);
+    CHECK(scheduler.admit(10).size() == 4);
+}
+
+// Requests behind a blocked one still take what it leaves over
+static void backfill_into_what_is_left() {
+    HostCapacity capacity;
+    capacity.cpu_pct = 400;
+    capacity.mem_mb = 1000;
+    AdmissionScheduler scheduler(capacity);
+
+    CHECK(scheduler.enqueue(0, request(300, 100)));
+    CHECK(scheduler.admit(10) == std::vector<size_t>{0});
+
+    // Short of CPU: only requests without CPU, within its memory share, pass it
+    CHECK(scheduler.enqueue(1, request(200, 500)));
+    CHECK(scheduler.enqueue(2, request(50, 100)));
+    CHECK(scheduler.enqueue(3, request(0, 500)));
+    CHECK(scheduler.enqueue(4, request(0, 300)));
+    CHECK(scheduler.admit(10) == std::vector<size_t>{4});
+
+    scheduler.release(0);
+    CHECK(scheduler.admit(10) == (std::vector<size_t>{1, 2}));
+    CHECK(scheduler.waiting() == 1);
+}
+
+int main() {
+    large_head_is_not_starved();
+    backfill_into_what_is_left();
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All scheduler checks passed" << std::endl;
+    return 0;
+}